@@ -0,0 +1,438 @@
+// dear imgui: Renderer Backend for a CPU framebuffer (software rasterizer, no GPU required)
+// This needs to be used along with a Platform Backend (e.g. GLFW, SDL, Win32, custom..)
+
+// Implemented features:
+//  [X] Renderer: User texture binding. Use 'ImGui_ImplSoft_Texture*' as void*/ImTextureID.
+//  [X] Renderer: Scissor clipping, vertex colors, alpha blending (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA).
+// Missing features:
+//  [ ] Renderer: Textures are point sampled. Set 'io.Fonts->Flags |= ImFontAtlasFlags_NoBakedLines' for exact anti-aliased lines.
+
+// The rasterizer walks each triangle one scanline at a time. Span ends are found by intersecting the row center
+// with the triangle edges (endpoints sorted by y, so two triangles sharing an edge compute bit-identical spans and
+// never blend the same pixel twice). Triangles with a single color and a single UV - the vast majority of what
+// Dear ImGui emits, as every solid fill samples the atlas white pixel - are filled with SSE2, four pixels at a time.
+// Everything else (glyphs, gradients, anti-aliased fringes) interpolates UV and color per pixel.
+
+#include "imgui.h"
+#include "imgui_impl_soft.h"
+#include <stdio.h>
+#include <math.h>
+#if defined(_MSC_VER) && _MSC_VER <= 1500 // MSVC 2008 or earlier
+#include <stddef.h>     // intptr_t
+#else
+#include <stdint.h>     // intptr_t
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMGUI_IMPL_SOFT_SSE2
+#endif
+
+struct ImGui_ImplSoft_Data
+{
+    ImGui_ImplSoft_Texture  FontTexture;
+    ImVector<ImU32>         FontPixels;
+    ImVector<ImU32>         Framebuffer;
+    int                     FramebufferWidth;
+    int                     FramebufferHeight;
+
+    ImGui_ImplSoft_Data() { FontTexture.Width = FontTexture.Height = 0; FontTexture.Pixels = NULL; FramebufferWidth = FramebufferHeight = 0; }
+};
+
+// Backend data stored in io.BackendRendererUserData to allow support for multiple Dear ImGui contexts
+static ImGui_ImplSoft_Data* ImGui_ImplSoft_GetBackendData()
+{
+    return ImGui::GetCurrentContext() ? (ImGui_ImplSoft_Data*)ImGui::GetIO().BackendRendererUserData : NULL;
+}
+
+// Functions
+bool    ImGui_ImplSoft_Init()
+{
+    ImGuiIO& io = ImGui::GetIO();
+    IM_ASSERT(io.BackendRendererUserData == NULL && "Already initialized a renderer backend!");
+
+    ImGui_ImplSoft_Data* bd = IM_NEW(ImGui_ImplSoft_Data)();
+    io.BackendRendererUserData = (void*)bd;
+    io.BackendRendererName = "imgui_impl_soft";
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;  // We index through cmd->VtxOffset, so large meshes are fine.
+
+    return true;
+}
+
+void    ImGui_ImplSoft_Shutdown()
+{
+    ImGui_ImplSoft_Data* bd = ImGui_ImplSoft_GetBackendData();
+    IM_ASSERT(bd != NULL && "No renderer backend to shutdown, or already shutdown?");
+    ImGuiIO& io = ImGui::GetIO();
+
+    ImGui_ImplSoft_DestroyFontsTexture();
+    io.BackendRendererName = NULL;
+    io.BackendRendererUserData = NULL;
+    io.BackendFlags &= ~ImGuiBackendFlags_RendererHasVtxOffset;
+    IM_DELETE(bd);
+}
+
+void    ImGui_ImplSoft_NewFrame()
+{
+    ImGui_ImplSoft_Data* bd = ImGui_ImplSoft_GetBackendData();
+    IM_ASSERT(bd != NULL && "Did you call ImGui_ImplSoft_Init()?");
+
+    if (!bd->FontTexture.Pixels)
+        ImGui_ImplSoft_CreateFontsTexture();
+}
+
+static void ImGui_ImplSoft_ResizeFramebuffer(ImGui_ImplSoft_Data* bd, int fb_width, int fb_height)
+{
+    if (bd->FramebufferWidth == fb_width && bd->FramebufferHeight == fb_height)
+        return;
+    bd->Framebuffer.resize(fb_width * fb_height);
+    bd->FramebufferWidth = fb_width;
+    bd->FramebufferHeight = fb_height;
+}
+
+//-----------------------------------------------------------------------------
+// Pixel helpers
+//-----------------------------------------------------------------------------
+
+template<typename T> static inline T ImGui_ImplSoft_Min(T a, T b) { return a < b ? a : b; }
+template<typename T> static inline T ImGui_ImplSoft_Max(T a, T b) { return a >= b ? a : b; }
+
+// Exact (a*b)/255 rounded, for a,b in [0,255]
+static inline ImU32 ImGui_ImplSoft_Mul255(ImU32 a, ImU32 b)
+{
+    ImU32 x = a * b + 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+static inline ImU32 ImGui_ImplSoft_Modulate(ImU32 texel, ImU32 col)
+{
+    ImU32 r = ImGui_ImplSoft_Mul255((texel >> IM_COL32_R_SHIFT) & 0xFF, (col >> IM_COL32_R_SHIFT) & 0xFF);
+    ImU32 g = ImGui_ImplSoft_Mul255((texel >> IM_COL32_G_SHIFT) & 0xFF, (col >> IM_COL32_G_SHIFT) & 0xFF);
+    ImU32 b = ImGui_ImplSoft_Mul255((texel >> IM_COL32_B_SHIFT) & 0xFF, (col >> IM_COL32_B_SHIFT) & 0xFF);
+    ImU32 a = ImGui_ImplSoft_Mul255((texel >> IM_COL32_A_SHIFT) & 0xFF, (col >> IM_COL32_A_SHIFT) & 0xFF);
+    return (r << IM_COL32_R_SHIFT) | (g << IM_COL32_G_SHIFT) | (b << IM_COL32_B_SHIFT) | (a << IM_COL32_A_SHIFT);
+}
+
+// dst = src * src.a + dst * (1 - src.a), on all four channels (same as glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA))
+static inline ImU32 ImGui_ImplSoft_Blend(ImU32 src, ImU32 dst)
+{
+    ImU32 sa = (src >> IM_COL32_A_SHIFT) & 0xFF;
+    if (sa == 0xFF)
+        return src;
+    if (sa == 0)
+        return dst;
+    ImU32 ia = 255 - sa;
+    ImU32 out = 0;
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        ImU32 x = ((src >> shift) & 0xFF) * sa + ((dst >> shift) & 0xFF) * ia + 128;
+        out |= ((x + (x >> 8)) >> 8) << shift;
+    }
+    return out;
+}
+
+static inline ImU32 ImGui_ImplSoft_Sample(const ImGui_ImplSoft_Texture* tex, float u, float v)
+{
+    int x = (int)(u * tex->Width);
+    int y = (int)(v * tex->Height);
+    x = x < 0 ? 0 : x >= tex->Width ? tex->Width - 1 : x;
+    y = y < 0 ? 0 : y >= tex->Height ? tex->Height - 1 : y;
+    return tex->Pixels[y * tex->Width + x];
+}
+
+// Blend a constant color over a horizontal span of pixels
+static void ImGui_ImplSoft_FillSpan(ImU32* dst, int count, ImU32 src)
+{
+    ImU32 sa = (src >> IM_COL32_A_SHIFT) & 0xFF;
+    if (sa == 0)
+        return;
+#ifdef IMGUI_IMPL_SOFT_SSE2
+    if (sa == 0xFF)
+    {
+        __m128i s = _mm_set1_epi32((int)src);
+        for (; count >= 4; count -= 4, dst += 4)
+            _mm_storeu_si128((__m128i*)dst, s);
+    }
+    else
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i src_term = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(_mm_set1_epi32((int)src), zero), _mm_set1_epi16((short)sa)), _mm_set1_epi16(128));
+        const __m128i inv_alpha = _mm_set1_epi16((short)(255 - sa));
+        for (; count >= 4; count -= 4, dst += 4)
+        {
+            __m128i d = _mm_loadu_si128((const __m128i*)dst);
+            __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), inv_alpha), src_term);
+            __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), inv_alpha), src_term);
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+            _mm_storeu_si128((__m128i*)dst, _mm_packus_epi16(lo, hi));
+        }
+    }
+#endif
+    for (; count > 0; count--, dst++)
+        *dst = ImGui_ImplSoft_Blend(src, *dst);
+}
+
+//-----------------------------------------------------------------------------
+// Triangle rasterization
+//-----------------------------------------------------------------------------
+
+struct ImGui_ImplSoft_ClipRect
+{
+    int MinX, MinY, MaxX, MaxY;     // Pixel bounds, max exclusive
+};
+
+// Attribute plane: value(x,y) = C + DX*x + DY*y
+struct ImGui_ImplSoft_Plane
+{
+    float C, DX, DY;
+};
+
+static inline ImGui_ImplSoft_Plane ImGui_ImplSoft_MakePlane(const ImVec2 p[3], float inv_area, float a0, float a1, float a2)
+{
+    ImGui_ImplSoft_Plane plane;
+    plane.DX = ((a1 - a0) * (p[2].y - p[0].y) - (a2 - a0) * (p[1].y - p[0].y)) * inv_area;
+    plane.DY = ((a2 - a0) * (p[1].x - p[0].x) - (a1 - a0) * (p[2].x - p[0].x)) * inv_area;
+    plane.C = a0 - plane.DX * p[0].x - plane.DY * p[0].y;
+    return plane;
+}
+
+// Horizontal extent [x_min, x_max) covered by the triangle on the row whose center is 'yc'
+static inline bool ImGui_ImplSoft_RowSpan(const ImVec2 p[3], float yc, float* x_min, float* x_max)
+{
+    float xs[2];
+    int n = 0;
+    for (int e = 0; e < 3 && n < 2; e++)
+    {
+        ImVec2 a = p[e], b = p[(e + 1) % 3];
+        if (a.y > b.y) { ImVec2 t = a; a = b; b = t; }
+        if (yc < a.y || yc >= b.y)
+            continue;
+        xs[n++] = a.x + (yc - a.y) * (b.x - a.x) / (b.y - a.y);
+    }
+    if (n < 2)
+        return false;
+    *x_min = xs[0] < xs[1] ? xs[0] : xs[1];
+    *x_max = xs[0] < xs[1] ? xs[1] : xs[0];
+    return true;
+}
+
+static void ImGui_ImplSoft_RasterizeTriangle(ImGui_ImplSoft_Data* bd, const ImGui_ImplSoft_Texture* tex, const ImDrawVert* v[3], const ImVec2 p[3], const ImGui_ImplSoft_ClipRect& clip)
+{
+    float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+    if (fabsf(area) < 1e-6f)
+        return;
+
+    float min_y = ImGui_ImplSoft_Min(p[0].y, ImGui_ImplSoft_Min(p[1].y, p[2].y));
+    float max_y = ImGui_ImplSoft_Max(p[0].y, ImGui_ImplSoft_Max(p[1].y, p[2].y));
+    int y0 = ImGui_ImplSoft_Max(clip.MinY, (int)ceilf(min_y - 0.5f));
+    int y1 = ImGui_ImplSoft_Min(clip.MaxY, (int)ceilf(max_y - 0.5f));
+    if (y0 >= y1)
+        return;
+
+    const bool flat_color = v[0]->col == v[1]->col && v[0]->col == v[2]->col;
+    const bool flat_uv = v[0]->uv.x == v[1]->uv.x && v[0]->uv.x == v[2]->uv.x && v[0]->uv.y == v[1]->uv.y && v[0]->uv.y == v[2]->uv.y;
+
+    // Fast path: constant color, blended a whole span at a time
+    ImU32 flat_src = 0;
+    if (flat_color && flat_uv)
+    {
+        flat_src = v[0]->col;
+        if (tex)
+            flat_src = ImGui_ImplSoft_Modulate(ImGui_ImplSoft_Sample(tex, v[0]->uv.x, v[0]->uv.y), flat_src);
+        if (((flat_src >> IM_COL32_A_SHIFT) & 0xFF) == 0)
+            return;
+    }
+
+    const float inv_area = 1.0f / area;
+    ImGui_ImplSoft_Plane plane_u = {}, plane_v = {}, plane_col[4] = {};
+    if (!flat_uv)
+    {
+        plane_u = ImGui_ImplSoft_MakePlane(p, inv_area, v[0]->uv.x, v[1]->uv.x, v[2]->uv.x);
+        plane_v = ImGui_ImplSoft_MakePlane(p, inv_area, v[0]->uv.y, v[1]->uv.y, v[2]->uv.y);
+    }
+    if (!flat_color)
+        for (int c = 0; c < 4; c++)
+            plane_col[c] = ImGui_ImplSoft_MakePlane(p, inv_area, (float)((v[0]->col >> (c * 8)) & 0xFF), (float)((v[1]->col >> (c * 8)) & 0xFF), (float)((v[2]->col >> (c * 8)) & 0xFF));
+
+    for (int y = y0; y < y1; y++)
+    {
+        const float yc = y + 0.5f;
+        float span_min, span_max;
+        if (!ImGui_ImplSoft_RowSpan(p, yc, &span_min, &span_max))
+            continue;
+        int x0 = ImGui_ImplSoft_Max(clip.MinX, (int)ceilf(span_min - 0.5f));
+        int x1 = ImGui_ImplSoft_Min(clip.MaxX, (int)ceilf(span_max - 0.5f));
+        if (x0 >= x1)
+            continue;
+
+        ImU32* dst = bd->Framebuffer.Data + y * bd->FramebufferWidth;
+        if (flat_color && flat_uv)
+        {
+            ImGui_ImplSoft_FillSpan(dst + x0, x1 - x0, flat_src);
+            continue;
+        }
+
+        for (int x = x0; x < x1; x++)
+        {
+            const float xc = x + 0.5f;
+            ImU32 col = v[0]->col;
+            if (!flat_color)
+            {
+                col = 0;
+                for (int c = 0; c < 4; c++)
+                {
+                    float f = plane_col[c].C + plane_col[c].DX * xc + plane_col[c].DY * yc;
+                    int ci = (int)(f + 0.5f);
+                    col |= (ImU32)(ci < 0 ? 0 : ci > 255 ? 255 : ci) << (c * 8);
+                }
+            }
+            ImU32 src = col;
+            if (tex)
+            {
+                float u = flat_uv ? v[0]->uv.x : plane_u.C + plane_u.DX * xc + plane_u.DY * yc;
+                float t = flat_uv ? v[0]->uv.y : plane_v.C + plane_v.DX * xc + plane_v.DY * yc;
+                src = ImGui_ImplSoft_Modulate(ImGui_ImplSoft_Sample(tex, u, t), col);
+            }
+            dst[x] = ImGui_ImplSoft_Blend(src, dst[x]);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Public API
+//-----------------------------------------------------------------------------
+
+void ImGui_ImplSoft_Clear(const ImVec4& color)
+{
+    ImGui_ImplSoft_Data* bd = ImGui_ImplSoft_GetBackendData();
+    IM_ASSERT(bd != NULL && "Did you call ImGui_ImplSoft_Init()?");
+    ImGuiIO& io = ImGui::GetIO();
+    ImGui_ImplSoft_ResizeFramebuffer(bd, (int)(io.DisplaySize.x * io.DisplayFramebufferScale.x), (int)(io.DisplaySize.y * io.DisplayFramebufferScale.y));
+
+    // Pre-multiplied like the glClearColor() call in our main.cpp
+    ImU32 col = ImGui::ColorConvertFloat4ToU32(ImVec4(color.x * color.w, color.y * color.w, color.z * color.w, color.w));
+    for (int n = 0; n < bd->Framebuffer.Size; n++)
+        bd->Framebuffer.Data[n] = col;
+}
+
+void ImGui_ImplSoft_RenderDrawData(ImDrawData* draw_data)
+{
+    ImGui_ImplSoft_Data* bd = ImGui_ImplSoft_GetBackendData();
+
+    // Avoid rendering when minimized, scale coordinates for retina displays (screen coordinates != framebuffer coordinates)
+    int fb_width = (int)(draw_data->DisplaySize.x * draw_data->FramebufferScale.x);
+    int fb_height = (int)(draw_data->DisplaySize.y * draw_data->FramebufferScale.y);
+    if (fb_width <= 0 || fb_height <= 0)
+        return;
+    ImGui_ImplSoft_ResizeFramebuffer(bd, fb_width, fb_height);
+
+    // Will project vertices and scissor/clipping rectangles into framebuffer space
+    ImVec2 clip_off = draw_data->DisplayPos;         // (0,0) unless using multi-viewports
+    ImVec2 clip_scale = draw_data->FramebufferScale; // (1,1) unless using retina display which are often (2,2)
+
+    // Render command lists
+    for (int n = 0; n < draw_data->CmdListsCount; n++)
+    {
+        const ImDrawList* cmd_list = draw_data->CmdLists[n];
+        const ImDrawVert* vtx_buffer = cmd_list->VtxBuffer.Data;
+        const ImDrawIdx* idx_buffer = cmd_list->IdxBuffer.Data;
+
+        for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
+        {
+            const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
+            if (pcmd->UserCallback)
+            {
+                // User callback, registered via ImDrawList::AddCallback()
+                // (ImDrawCallback_ResetRenderState is a special callback value used by the user to request the renderer to reset render state.)
+                if (pcmd->UserCallback != ImDrawCallback_ResetRenderState)
+                    pcmd->UserCallback(cmd_list, pcmd);
+                continue;
+            }
+
+            // Project scissor/clipping rectangles into framebuffer space
+            ImVec2 clip_min((pcmd->ClipRect.x - clip_off.x) * clip_scale.x, (pcmd->ClipRect.y - clip_off.y) * clip_scale.y);
+            ImVec2 clip_max((pcmd->ClipRect.z - clip_off.x) * clip_scale.x, (pcmd->ClipRect.w - clip_off.y) * clip_scale.y);
+            ImGui_ImplSoft_ClipRect clip;
+            clip.MinX = ImGui_ImplSoft_Max(0, (int)clip_min.x);
+            clip.MinY = ImGui_ImplSoft_Max(0, (int)clip_min.y);
+            clip.MaxX = ImGui_ImplSoft_Min(fb_width, (int)clip_max.x);
+            clip.MaxY = ImGui_ImplSoft_Min(fb_height, (int)clip_max.y);
+            if (clip.MaxX <= clip.MinX || clip.MaxY <= clip.MinY)
+                continue;
+
+            const ImGui_ImplSoft_Texture* tex = (const ImGui_ImplSoft_Texture*)pcmd->GetTexID();
+            const ImDrawVert* vtx = vtx_buffer + pcmd->VtxOffset;
+            const ImDrawIdx* idx = idx_buffer + pcmd->IdxOffset;
+            for (unsigned int i = 0; i + 2 < pcmd->ElemCount; i += 3)
+            {
+                const ImDrawVert* v[3] = { &vtx[idx[i]], &vtx[idx[i + 1]], &vtx[idx[i + 2]] };
+                ImVec2 p[3];
+                for (int k = 0; k < 3; k++)
+                    p[k] = ImVec2((v[k]->pos.x - clip_off.x) * clip_scale.x, (v[k]->pos.y - clip_off.y) * clip_scale.y);
+                ImGui_ImplSoft_RasterizeTriangle(bd, tex, v, p, clip);
+            }
+        }
+    }
+}
+
+const ImU32* ImGui_ImplSoft_GetFramebuffer(int* out_width, int* out_height)
+{
+    ImGui_ImplSoft_Data* bd = ImGui_ImplSoft_GetBackendData();
+    IM_ASSERT(bd != NULL && "Did you call ImGui_ImplSoft_Init()?");
+    if (out_width) *out_width = bd->FramebufferWidth;
+    if (out_height) *out_height = bd->FramebufferHeight;
+    return bd->Framebuffer.Data;
+}
+
+bool ImGui_ImplSoft_SaveScreenshot(const char* filename)
+{
+    ImGui_ImplSoft_Data* bd = ImGui_ImplSoft_GetBackendData();
+    IM_ASSERT(bd != NULL && "Did you call ImGui_ImplSoft_Init()?");
+    FILE* f = fopen(filename, "wb");
+    if (!f)
+        return false;
+    fprintf(f, "P6\n%d %d\n255\n", bd->FramebufferWidth, bd->FramebufferHeight);
+    for (int n = 0; n < bd->Framebuffer.Size; n++)
+    {
+        ImU32 px = bd->Framebuffer.Data[n];
+        unsigned char rgb[3] = { (unsigned char)(px >> IM_COL32_R_SHIFT), (unsigned char)(px >> IM_COL32_G_SHIFT), (unsigned char)(px >> IM_COL32_B_SHIFT) };
+        fwrite(rgb, 1, 3, f);
+    }
+    bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok;
+}
+
+bool ImGui_ImplSoft_CreateFontsTexture()
+{
+    // Build texture atlas
+    ImGuiIO& io = ImGui::GetIO();
+    ImGui_ImplSoft_Data* bd = ImGui_ImplSoft_GetBackendData();
+    unsigned char* pixels;
+    int width, height;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+    // Keep our own copy so the atlas is free to ClearTexData()
+    bd->FontPixels.resize(width * height);
+    memcpy(bd->FontPixels.Data, pixels, (size_t)width * height * 4);
+    bd->FontTexture.Width = width;
+    bd->FontTexture.Height = height;
+    bd->FontTexture.Pixels = bd->FontPixels.Data;
+
+    // Store our identifier
+    io.Fonts->SetTexID((ImTextureID)&bd->FontTexture);
+
+    return true;
+}
+
+void ImGui_ImplSoft_DestroyFontsTexture()
+{
+    ImGuiIO& io = ImGui::GetIO();
+    ImGui_ImplSoft_Data* bd = ImGui_ImplSoft_GetBackendData();
+    if (bd->FontTexture.Pixels)
+    {
+        io.Fonts->SetTexID(0);
+        bd->FontPixels.clear();
+        bd->FontTexture.Pixels = NULL;
+    }
+}
@@ -0,0 +1,36 @@
+// dear imgui: Renderer Backend for a CPU framebuffer (software rasterizer, no GPU required)
+// This needs to be used along with a Platform Backend (e.g. GLFW, SDL, Win32, custom..)
+
+// Implemented features:
+//  [X] Renderer: User texture binding. Use 'ImGui_ImplSoft_Texture*' as void*/ImTextureID.
+//  [X] Renderer: Scissor clipping, vertex colors, alpha blending (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA).
+// Missing features:
+//  [ ] Renderer: Textures are point sampled. Set 'io.Fonts->Flags |= ImFontAtlasFlags_NoBakedLines' for exact anti-aliased lines.
+
+// The framebuffer is stored as packed ImU32 pixels using the same layout as IM_COL32() (R,G,B,A in memory order
+// unless IMGUI_USE_BGRA_PACKED_COLOR is defined). It is meant for headless benchmarks and screenshot diffs,
+// not for presenting to a window.
+
+#pragma once
+#include "imgui.h"      // IMGUI_IMPL_API
+
+struct ImGui_ImplSoft_Texture
+{
+    int             Width;
+    int             Height;
+    const ImU32*    Pixels;     // Width*Height pixels, IM_COL32() layout
+};
+
+IMGUI_IMPL_API bool     ImGui_ImplSoft_Init();
+IMGUI_IMPL_API void     ImGui_ImplSoft_Shutdown();
+IMGUI_IMPL_API void     ImGui_ImplSoft_NewFrame();
+IMGUI_IMPL_API void     ImGui_ImplSoft_RenderDrawData(ImDrawData* draw_data);
+
+// Framebuffer access
+IMGUI_IMPL_API void     ImGui_ImplSoft_Clear(const ImVec4& color);
+IMGUI_IMPL_API const ImU32* ImGui_ImplSoft_GetFramebuffer(int* out_width, int* out_height);
+IMGUI_IMPL_API bool     ImGui_ImplSoft_SaveScreenshot(const char* filename);   // Binary PPM (P6), alpha dropped
+
+// Called by Init/NewFrame/Shutdown
+IMGUI_IMPL_API bool     ImGui_ImplSoft_CreateFontsTexture();
+IMGUI_IMPL_API void     ImGui_ImplSoft_DestroyFontsTexture();
@@ -10,7 +10,39 @@
 #include "imgui.h"
 #include "imgui_impl_sdl.h"
 #include "imgui_impl_opengl2.h"
+#include "imgui_impl_soft.h"
+#include "frame_stats.h"
+#include "replay.h"
+#include "alloc_profiler.h"
+#include "text_layout.h"
+#include "prefetch.h"
+#include "parallel_sort.h"
+#include "card_store.h"
+#include "card_schedule.h"
+#include "card_stats.h"
+#include "english_index.h"
+#include "pinyin_index.h"
+#include "hanzi_index.h"
+#include "answer_match.h"
+#include "confusables.h"
+#include "dictionary.h"
+#include "segmenter.h"
+#include "session_snapshot.h"
+#include "session_queue.h"
+#include "answer_history.h"
+#include "alias_sampler.h"
+#include "review_server.h"
+#include "review_load.h"
+#include "review_log.h"
+#include "apkg_reader.h"
+#include "lesson_deck.h"
+#include "pinyin_audio.h"
 #include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/resource.h>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_opengl.h>
 #include <string>
@@ -21,6 +53,11 @@
 #include <iomanip>
 #include <algorithm>
 #include <random>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <atomic>
+#include <thread>
 
 namespace fs = std::filesystem;
 
@@ -29,7 +66,9 @@ typedef enum Page {
     FLASHCARD_SELECTION,
     SHOW_FLASHCARD,
     REVEAL_FLASHCARD,
-    SHOW_RESULTS
+    SHOW_RESULTS,
+    CARD_BROWSER,
+    STATISTICS
 } Page;
 
 typedef enum FlashcardField {
@@ -38,39 +77,235 @@ typedef enum FlashcardField {
     PINYIN = 4
 } FlashcardField;
 
-typedef enum CardStatus {
-    CORRECT,
-    INCORRECT,
-    UNDECIDED
-} CardStatus;
-
-typedef struct Flashcard {
-    std::string english;
-    std::string chinese;
-    std::string pinyin;
-    CardStatus status = UNDECIDED;
-} Flashcard;
-
 SDL_Window* window;
 SDL_GLContext gl_context;
 ImGuiIO* io;
 
-Page currentPage = LESSON_SELECTION;
-std::vector<std::vector<Flashcard>> lessons;
-int fields = 0;
-std::vector<Flashcard> active_set;
-std::vector<Flashcard> inactive_set;
-int currentCard = 0;
-auto rng = std::default_random_engine{std::random_device()()};
+// Per-lesson metadata, computed once at load so the selection page never walks the cards.
+// A lesson's cards are the consecutive ids [firstCard, firstCard + cardCount) in cardStore.
+typedef struct LessonInfo {
+    std::string label; // "Lesson N (M cards)"
+    CardId firstCard;
+    int cardCount;
+} LessonInfo;
+std::vector<LessonInfo> lessonInfo;
+
+// Card browser: sorting permutes browserOrder, a list of card ids
+std::vector<CardId> browserOrder;
+std::vector<uint32_t> browserRanks[3]; // per card, alphabetical rank of its English/Pinyin/Chinese text
+uint32_t browserRankCount[3];          // distinct strings per column
+typedef struct BrowserSortKey {
+    uint64_t key;
+    uint32_t card;
+} BrowserSortKey;
+std::vector<BrowserSortKey> browserKeys; // sort scratch, kept to avoid reallocating
+std::vector<BrowserSortKey> browserKeysScratch;
+char browserQuery[128] = "";
+bool browserFiltered = false;          // a search is active; browserRows holds its matches in sorted order
+std::vector<uint32_t> browserMatches;
+CardSet browserMatchSet;
+bool browserResort = false;            // the profile changed, so the status and due columns did
+
+// Recomputed every frame the statistics page is open, one entry per lesson
+std::vector<CardStats> lessonStats;
+CardStats libraryStats;
+double statsMs = 0.0;
+std::vector<uint32_t> browserRows;
+
+// Everything that belongs to one learner: their schedule, their choices and the session in
+// progress. The cards themselves are in cardStore, shared by every profile, so a profile
+// costs its schedule (11 bytes a card) and some tens of KB for the session.
+typedef struct Profile {
+    std::string name;
+    std::string sessionPath;            // where the session in progress is saved
+    CardSchedule schedule;              // replayed from reviewLog at start, then kept up with it
+    ReviewLog reviewLog;                // every answer, from this install and any synced with
+    Page currentPage = LESSON_SELECTION;
+
+    std::vector<char> lessonSelected;   // one per lesson; char rather than bool so &lessonSelected[i] is addressable
+    int selectedLessonCount = 0;
+    int selectedCardCount = 0;
+    int lastClickedLesson = -1;         // anchor for shift-click range selection
+
+    bool showEnglish = false;           // the field page's choices, turned into 'fields' by its Next
+    bool showChinese = false;
+    bool showPinyin = false;
+    int fields = 0;
+    bool typedAnswers = false;          // the user types the answer and it's graded, instead of flipping
+    char typedAnswer[128] = "";
+    bool groupConfusables = false;      // sessions put look-alike cards next to each other
+    AnswerGrade typedGrade = {};
+    bool typedGraded = false;           // typedGrade is for the card on show
+    std::vector<CardId> sessionCards;   // gathered for a new session, then shuffled into active_set
+    SessionQueue active_set;            // cards still to answer this session, the one on show first
+    std::vector<CardId> inactive_set;
+    AnswerHistory answerHistory = AnswerHistory(1024); // answers of this session that can be undone
+    bool weightedPractice = false;      // draw each next card by difficulty instead of following the shuffle
+    bool weightedSession = false;       // weightedPractice, as it was when the session in progress began
+    AliasSampler practiceSampler;       // over sessionCards by index; zero for cards already done
+    std::vector<uint32_t> practiceItem; // index into sessionCards, by CardId
+    int currentCard = 0;
+    std::default_random_engine rng;
+
+    bool sessionChanged = false;
+    SessionSnapshot sessionSnapshot = {};   // filled on the UI thread, then handed to snapshotWriter
+    SessionSnapshot resumableSession = {};
+    bool canResume = false;
+    SnapshotWriter snapshotWriter;
+} Profile;
+std::deque<Profile> profiles;       // a deque, so adding a profile doesn't move the others
+Profile* profile = nullptr;         // the one in use
+char newProfileName[32] = "";
+unsigned int rngSeed = std::random_device()(); // the first profile's; later ones count up from it
 
 ImFont* en_large;
 ImFont* cn_large;
 float large_font_size = 48.0f;
+ImVector<ImWchar> cnGlyphRanges;
+std::vector<ImWchar> extraGlyphs; // found missing by the prefetcher, added on the next font rebuild
+
+// Headless mode renders with the software backend into an offscreen framebuffer,
+// so full frames can be benchmarked and screenshotted on machines without a GPU
+bool headless = false;
+int maxFrames = -1; // 0 = unlimited; defaults to 600 in headless mode unless replaying
+const char* screenshotPath = nullptr;
+
+// Input record/replay and frame timing, for reproducible performance runs
+InputRecorder recorder;
+InputReplay replay;
+const char* recordPath = nullptr;
+const char* replayPath = nullptr;
+const char* histogramPath = nullptr;
+FrameStats frameStats;
+
+// Debug overlay (F1) and heap allocation accounting
+bool showOverlay = false;
+double lastFrameMs = 0.0;
+FrameAllocTracker allocTracker;
+bool failOnAlloc = false;
+uint32_t allocWarmupFrames = 60;
+
+// CC-CEDICT, for filling in cards that only have their chinese; the parsed trie is cached beside it
+std::string cedictPath = "cedict_ts.u8";
+// --make-deck: segment a corpus and write its most frequent new words as lessons, then exit
+const char* deckCorpusPath = nullptr;
+int deckSize = 200;
+const int deckLessonSize = 30;
+// --import: stream an Anki .apkg's notes into new lessons, then exit. --fields gives the note
+// field numbers (from 1, 0 for none) of the english, pinyin and chinese; otherwise they're
+// guessed from the first notes.
+const char* importPath = nullptr;
+const char* importFields = nullptr;
+bool importPacked = false;              // --packed: write lessonN.deck instead of lessonN.csv
+int importLessonSize = deckLessonSize;
+const size_t importSampleNotes = 100;
+// --serve: no window; local clients take cards and grade them over a socket, through the same
+// session functions as the flashcard pages. Sessions are only saved if --session is given.
+const char* serveAddress = nullptr;
+ReviewServer reviewServer;
+std::string reviewText;                 // NEXT's payload, kept to avoid reallocating
+std::vector<LogClock> syncClocks;       // SYNC's and PUSH's working space, likewise
+std::vector<char> syncPayload;
+std::vector<CardId> syncTouched;
+// --load-test: grade against a server from several connections and report the rate, then exit
+const char* loadTestAddress = nullptr;
+int loadClients = 8;
+int loadBatch = 64;
+double loadSeconds = 5.0;
+
+// The session in progress is saved here after every change (written at most every couple of
+// seconds, on a worker thread) and offered for resuming at the next start. Off for replays
+// unless --session is given, so they always start from the lesson page. Profiles after the
+// first save theirs beside it, with their name added.
+const char* sessionSnapshotPath = "session.bin";
+bool sessionPathGiven = false;
+bool sessionSnapshots = true;
+// Profile names, one per line, kept and read whenever sessions are
+const char* profilesPath = "profiles.txt";
+// Each profile's answers, named like its session file. The install id tells this install's
+// answers from those synced in from others; it's made up on the first run and kept.
+const char* reviewLogPath = "reviews.log";
+const char* installIdPath = "install.id";
+uint64_t installId = 0;
+// --sync: exchange every profile's new answers with a --serve server, then exit
+const char* syncAddress = nullptr;
+const char* startProfile = nullptr;     // --profile: start as this one, adding it if needed
+// The cards, mapped read-only once loaded and shared with every profile and process
+const char* cardStorePath = "cards.bin";
+// Syllable recordings for saying each card's pinyin when it's flipped; silent without them.
+// --make-audio-pack: pack a directory of WAV files (hao3.wav, ...) into it, then exit.
+const char* audioPackPath = "audio.pack";
+const char* audioPackDirectory = nullptr;
+// Look-alike cards are paired on their own thread once the library is loaded, which takes
+// seconds for a large one; "Practice look-alikes together" is offered when it's done
+std::thread confusableCommitter;
+std::atomic<bool> confusablesReady(false);
+
+// Time from an answer button to the end of the frame showing the next card
+FrameStats answerLatency;
+Uint64 answerPressedAt = 0;
+uint32_t answerFrame = 0;
+uint32_t currentFrame = 0;
+double lastAnswerLatencyMs = 0.0;
+
+void loadFonts() {
+    io->Fonts->Clear();
+    static const ImWchar latinRanges[] = { 0x0020, 0x024F, 0 }; // Latin-1 and Extended-A/B, for pinyin tone marks
+    io->Fonts->AddFontFromFileTTF("fonts/Roboto-Regular.ttf", 18.0f, NULL, latinRanges);
+
+    ImFontGlyphRangesBuilder glyphs;
+    glyphs.AddRanges(io->Fonts->GetGlyphRangesChineseFull());
+    for (ImWchar c : extraGlyphs) {
+        glyphs.AddChar(c);
+    }
+    cnGlyphRanges.clear();
+    glyphs.BuildRanges(&cnGlyphRanges);
+    cn_large = io->Fonts->AddFontFromFileTTF("fonts/NotoSansSC-Thin.otf", large_font_size, NULL, cnGlyphRanges.Data);
+    io->Fonts->Build();
+}
+
+// Rebuilds the atlas between frames when upcoming cards need glyphs it lacks.
+// Returns true if it did.
+bool addMissingGlyphs() {
+    std::vector<ImWchar> missing;
+    if (!prefetcher.takeMissingGlyphs(missing)) {
+        return false;
+    }
+    size_t previousCount = extraGlyphs.size();
+    for (ImWchar c : missing) {
+        // take the whole 128 code point block, pinyin tone marks tend to come in groups
+        for (int block = std::max(c & ~0x7F, 0x20); block <= (c | 0x7F); block++) {
+            if (std::find(extraGlyphs.begin(), extraGlyphs.end(), (ImWchar)block) == extraGlyphs.end()) {
+                extraGlyphs.push_back((ImWchar)block);
+            }
+        }
+    }
+    if (extraGlyphs.size() == previousCount) {
+        return false; // already asked for, the font file just doesn't have them
+    }
+
+    prefetcher.waitIdle();
+    loadFonts();
+    if (headless) {
+        ImGui_ImplSoft_DestroyFontsTexture();
+        ImGui_ImplSoft_CreateFontsTexture();
+    } else {
+        ImGui_ImplOpenGL2_DestroyFontsTexture();
+        ImGui_ImplOpenGL2_CreateFontsTexture();
+    }
+    textLayouts.clear();
+    return true;
+}
 
 int setup() {
     // Setup SDL
     // (Some versions of SDL before <2.0.10 appears to have performance/stalling issues on a minority of Windows systems,
     // depending on whether SDL_INIT_GAMECONTROLLER is enabled or disabled.. updating to the latest version of SDL is recommended!)
+    if (headless) {
+        // no display needed, but still honour an explicit SDL_VIDEODRIVER
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+        SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+    }
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0)
     {
         printf("Error: %s\n", SDL_GetError());
@@ -78,57 +313,78 @@ int setup() {
     }
 
     // Setup window
-    SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
-    SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
-
-    SDL_WindowFlags window_flags = (SDL_WindowFlags)(SDL_WINDOW_OPENGL | SDL_WINDOW_ALLOW_HIGHDPI);
-    window = SDL_CreateWindow("Chinese Flashcards", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 550, 230, window_flags);
-    gl_context = SDL_GL_CreateContext(window);
-    SDL_GL_MakeCurrent(window, gl_context);
+    if (headless) {
+        window = SDL_CreateWindow("Chinese Flashcards", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 550, 230, SDL_WINDOW_HIDDEN);
+    } else {
+        SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+        SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+        SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
+
+        SDL_WindowFlags window_flags = (SDL_WindowFlags)(SDL_WINDOW_OPENGL | SDL_WINDOW_ALLOW_HIGHDPI);
+        window = SDL_CreateWindow("Chinese Flashcards", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 550, 230, window_flags);
+        gl_context = SDL_GL_CreateContext(window);
+        SDL_GL_MakeCurrent(window, gl_context);
+    }
     
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
+    installImGuiAllocHooks();
     ImGui::CreateContext();
     io = &ImGui::GetIO();
-    io->Fonts->AddFontFromFileTTF("fonts/Roboto-Regular.ttf", 18.0f);
-    cn_large = io->Fonts->AddFontFromFileTTF("fonts/NotoSansSC-Thin.otf", large_font_size, NULL, io->Fonts->GetGlyphRangesChineseFull());
-    io->Fonts->Build();
+    loadFonts();
     ImGui::StyleColorsDark();
 
     // Setup Platform/Renderer backends
     ImGui_ImplSDL2_InitForOpenGL(window, gl_context);
-    ImGui_ImplOpenGL2_Init();
+    if (headless) {
+        ImGui_ImplSoft_Init();
+    } else {
+        ImGui_ImplOpenGL2_Init();
+    }
 
     return 0;
 }
 
 void cleanup() {
     // Cleanup
-    ImGui_ImplOpenGL2_Shutdown();
+    prefetcher.waitIdle();
+    pinyinAudio.close();
+    if (confusableCommitter.joinable()) {
+        confusableCommitter.join();
+    }
+    if (headless) {
+        ImGui_ImplSoft_Shutdown();
+    } else {
+        ImGui_ImplOpenGL2_Shutdown();
+    }
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
 
-    SDL_GL_DeleteContext(gl_context);
+    if (gl_context) {
+        SDL_GL_DeleteContext(gl_context);
+    }
     SDL_DestroyWindow(window);
     SDL_Quit();
 }
 
-void TextCentered(std::string text) {
+void TextCentered(std::string_view text) {
     auto windowWidth = ImGui::GetWindowSize().x;
-    auto textWidth   = ImGui::CalcTextSize(text.c_str()).x;
+    auto wrapWidth   = windowWidth - 2.0f * ImGui::GetStyle().WindowPadding.x;
+    const TextLayout& layout = textLayouts.get(text, wrapWidth);
 
-    ImGui::SetCursorPosX((windowWidth - textWidth) * 0.5f);
-    ImGui::Text("%s", text.c_str());
+    for (const TextLine& line : layout.lines) {
+        ImGui::SetCursorPosX((windowWidth - line.width) * 0.5f);
+        ImGui::TextUnformatted(text.data() + line.begin, text.data() + line.end);
+    }
 }
 
 void skipInvisibleFlashcardFields() {
     int invisibleFields = 0;
-    invisibleFields += !(fields & ENGLISH);
-    invisibleFields += !(fields & PINYIN);
-    invisibleFields += !(fields & CHINESE);
+    invisibleFields += !(profile->fields & ENGLISH);
+    invisibleFields += !(profile->fields & PINYIN);
+    invisibleFields += !(profile->fields & CHINESE);
     if (invisibleFields == 0) {
         return;
     }
@@ -136,219 +392,1761 @@ void skipInvisibleFlashcardFields() {
     ImGui::SetCursorPosY(ypos + invisibleFields*large_font_size);
 }
 
+// Lays out active_set[first, last) on the prefetch worker, with the same font
+// and wrap width TextCentered() will use for them
+void prefetchCards(size_t first, size_t last) {
+    ImGui::PushFont(cn_large);
+    float wrapWidth = ImGui::GetWindowSize().x - 2.0f * ImGui::GetStyle().WindowPadding.x;
+    for (size_t i = first; i < last && i < profile->active_set.size(); i++) {
+        CardId id = profile->active_set.at((uint32_t)i);
+        prefetcher.request(cardStore.english(id), ImGui::GetFont(), ImGui::GetFontSize(), wrapWidth);
+        prefetcher.request(cardStore.pinyin(id), ImGui::GetFont(), ImGui::GetFontSize(), wrapWidth);
+        prefetcher.request(cardStore.chinese(id), ImGui::GetFont(), ImGui::GetFontSize(), wrapWidth);
+    }
+    ImGui::PopFont();
+}
+
+// Checks every card of the session for glyphs the font lacks, as one job, so any font
+// rebuild happens before the first card rather than mid-session
+void prefetchSessionGlyphs() {
+    std::string text;
+    for (size_t i = 0; i < profile->active_set.size(); i++) {
+        CardId id = profile->active_set.at((uint32_t)i);
+        for (std::string_view field : { cardStore.english(id), cardStore.pinyin(id), cardStore.chinese(id) }) {
+            text.append(field);
+            text.push_back('\n');
+        }
+    }
+    prefetcher.requestGlyphs(std::move(text), cn_large);
+}
+
+// The current card and the next two, and the pronunciation of the next few
+void prefetchUpcomingCards() {
+    prefetchCards(0, 3);
+    CardId upcoming[PinyinAudio::PREFETCH_CARDS];
+    size_t count = std::min(PinyinAudio::PREFETCH_CARDS, (size_t)profile->active_set.size());
+    for (size_t i = 0; i < count; i++) {
+        upcoming[i] = profile->active_set.at((uint32_t)i);
+    }
+    pinyinAudio.prefetch(upcoming, count);
+}
+
+// Turns the front card over and says it
+void flipCard() {
+    profile->currentPage = REVEAL_FLASHCARD;
+    pinyinAudio.play(profile->active_set.front());
+}
+
+void markAnswered() {
+    answerPressedAt = SDL_GetPerformanceCounter();
+    answerFrame = currentFrame;
+}
+
+void clearTypedAnswer() {
+    profile->typedAnswer[0] = '\0';
+    profile->typedGraded = false;
+}
+
+// Typing needs a field to type that the card doesn't show; with English and pinyin both on
+// it, cards are flipped and graded by hand instead
+bool canTypeAnswer(int fields) {
+    return !(fields & ENGLISH) || !(fields & PINYIN);
+}
+
+// The field a typed answer is checked against: one the card doesn't show, English
+// before pinyin. Chinese isn't offered, since it can't be typed without an IME.
+std::string_view expectedAnswer(CardId id, bool* pinyin) {
+    *pinyin = (profile->fields & ENGLISH) && !(profile->fields & PINYIN);
+    return *pinyin ? cardStore.pinyin(id) : cardStore.english(id);
+}
+
+// Takes the front card's answer down along with its columns as they are before grading
+AnswerRecord recordAnswer(AnswerKind kind, uint32_t position) {
+    CardId card = profile->active_set.front();
+    AnswerRecord record;
+    record.card = card;
+    record.position = position;
+    record.drawnFrom = NO_DRAW;
+    record.day = currentDay();
+    record.due = profile->schedule.due[card];
+    record.interval = profile->schedule.interval[card];
+    record.ease = profile->schedule.ease[card];
+    record.lapses = profile->schedule.lapses[card];
+    record.status = profile->schedule.status[card];
+    record.kind = (uint8_t)kind;
+    return record;
+}
+
+// Cards that have been missed more, and cards further past due, come up more often
+double practiceWeight(CardId id, uint32_t today) {
+    double misses = (double)(CardSchedule::STARTING_EASE - profile->schedule.ease[id]) / CardSchedule::EASE_PENALTY;
+    uint32_t due = profile->schedule.due[id];
+    double overdueWeeks = due != 0 && due < today ? std::min(today - due, 28u) / 7.0 : 0.0;
+    return (1.0 + misses) * (1.0 + misses) * (1.0 + overdueWeeks);
+}
+
+void buildPracticeSampler() {
+    uint32_t today = currentDay();
+    profile->practiceItem.assign(cardStore.size(), AliasSampler::NONE);
+    for (uint32_t i = 0; i < profile->sessionCards.size(); i++) {
+        profile->practiceItem[profile->sessionCards[i]] = i;
+    }
+    std::vector<double> weights(profile->sessionCards.size(), 0.0);
+    for (uint32_t position = 0; position < profile->active_set.size(); position++) {
+        CardId id = profile->active_set.at(position);
+        weights[profile->practiceItem[id]] = practiceWeight(id, today);
+    }
+    profile->practiceSampler.build(weights);
+}
+
+void updatePracticeWeight(CardId id, bool inSession) {
+    if (profile->weightedSession) {
+        profile->practiceSampler.update(profile->practiceItem[id], inSession ? practiceWeight(id, currentDay()) : 0.0);
+    }
+}
+
+void moveToFront(uint32_t position) {
+    profile->active_set.insert(0, profile->active_set.erase(position));
+}
+
+// Weighted practice: draws the next card and brings it to the front, returning where it was.
+// The card just answered is redrawn while there are others, so it isn't shown twice running.
+uint32_t drawNextCard(CardId answered) {
+    if (!profile->weightedSession || profile->active_set.empty()) {
+        return NO_DRAW;
+    }
+    uint32_t item = AliasSampler::NONE;
+    for (int tries = 0; tries < 8; tries++) {
+        item = profile->practiceSampler.draw(profile->rng);
+        if (item == AliasSampler::NONE || profile->sessionCards[item] != answered) {
+            break;
+        }
+    }
+    if (item == AliasSampler::NONE) {
+        return NO_DRAW;
+    }
+    uint32_t position = profile->active_set.positionOf(profile->sessionCards[item]);
+    moveToFront(position);
+    return position;
+}
+
+// Grades the front card and moves it as the record says; redo replays records through here too
+void applyAnswer(const AnswerRecord& record) {
+    profile->active_set.erase(0);
+    if (record.kind == ANSWER_CORRECT) {
+        // a card missed earlier in the session stays missed
+        if (profile->schedule.status[record.card] != INCORRECT) {
+            profile->schedule.review(record.card, true, record.day);
+            profile->reviewLog.add(record.card, LOG_CORRECT, record.day);
+        }
+        profile->inactive_set.push_back(record.card);
+    } else {
+        profile->schedule.review(record.card, false, record.day);
+        profile->reviewLog.add(record.card, LOG_INCORRECT, record.day);
+        profile->active_set.insert(record.position, record.card);
+    }
+    updatePracticeWeight(record.card, record.kind == ANSWER_INCORRECT);
+    clearTypedAnswer();
+    profile->sessionChanged = true;
+    profile->currentPage = profile->active_set.empty() ? SHOW_RESULTS : SHOW_FLASHCARD;
+}
+
+// The front card was known; it leaves the session
+void answerCorrect() {
+    markAnswered();
+    AnswerRecord record = recordAnswer(ANSWER_CORRECT, 0);
+    applyAnswer(record);
+    record.drawnFrom = drawNextCard(record.card);
+    profile->answerHistory.push(record);
+}
+
+// The front card was missed; it comes back a few cards later
+void answerIncorrect() {
+    markAnswered();
+    uint32_t numLeft = profile->active_set.size() - 1;
+    uint32_t position = numLeft;
+    if (numLeft > 3) {
+        std::uniform_int_distribution<> distr(3, numLeft - 1);
+        position = (uint32_t)distr(profile->rng);
+    }
+    AnswerRecord record = recordAnswer(ANSWER_INCORRECT, position);
+    applyAnswer(record);
+    record.drawnFrom = drawNextCard(record.card);
+    profile->answerHistory.push(record);
+}
+
+// Brings the last answered card back to the front, graded as it was before
+void undoAnswer() {
+    const AnswerRecord& record = profile->answerHistory.undo();
+    if (record.drawnFrom != NO_DRAW) {
+        profile->active_set.insert(record.drawnFrom, profile->active_set.erase(0));
+    }
+    if (record.kind == ANSWER_CORRECT) {
+        profile->inactive_set.pop_back();
+    } else {
+        profile->active_set.erase(record.position);
+    }
+    profile->active_set.insert(0, record.card);
+    if (record.kind == ANSWER_INCORRECT || record.status != INCORRECT) {
+        profile->reviewLog.add(record.card, LOG_UNDO, record.day); // applyAnswer() logged it
+    }
+    profile->schedule.status[record.card] = record.status;
+    profile->schedule.due[record.card] = record.due;
+    profile->schedule.interval[record.card] = record.interval;
+    profile->schedule.ease[record.card] = record.ease;
+    profile->schedule.lapses[record.card] = record.lapses;
+    updatePracticeWeight(record.card, true);
+    clearTypedAnswer();
+    profile->sessionChanged = true;
+    profile->currentPage = SHOW_FLASHCARD;
+}
+
+void redoAnswer() {
+    AnswerRecord record = profile->answerHistory.redo();
+    applyAnswer(record);
+    if (record.drawnFrom != NO_DRAW) {
+        moveToFront(record.drawnFrom);
+    }
+}
+
+void startConfusableCommit() {
+    confusableCommitter = std::thread([] {
+        AllocScope scope(ALLOC_CONFUSABLES);
+        confusableIndex.commit();
+        confusablesReady = true;
+    });
+}
+
+// Keeps the shuffled order, but pulls each card's look-alikes from later in the session up
+// to follow it, so they're told apart side by side rather than drilled far apart
+void groupConfusableCards() {
+    std::unordered_map<CardId, size_t> sessionIndex;
+    for (size_t i = 0; i < profile->sessionCards.size(); i++) {
+        sessionIndex[profile->sessionCards[i]] = i;
+    }
+    std::vector<char> placed(profile->sessionCards.size(), 0);
+    std::vector<CardId> grouped;
+    grouped.reserve(profile->sessionCards.size());
+    for (size_t i = 0; i < profile->sessionCards.size(); i++) {
+        if (placed[i]) {
+            continue;
+        }
+        placed[i] = 1;
+        grouped.push_back(profile->sessionCards[i]);
+        for (const ConfusableNeighbor& neighbor : confusableIndex.neighbors(profile->sessionCards[i])) {
+            auto it = sessionIndex.find(neighbor.card);
+            if (it != sessionIndex.end() && !placed[it->second]) {
+                placed[it->second] = 1;
+                grouped.push_back(profile->sessionCards[it->second]);
+            }
+        }
+    }
+    profile->sessionCards = std::move(grouped);
+    profile->active_set.assign(profile->sessionCards);
+}
+
+// The session's cards, as --serve starts them too: sessionCards shuffled into the queue
+void beginSession() {
+    clearTypedAnswer();
+    profile->answerHistory.clear();
+    for (CardId id : profile->sessionCards) {
+        profile->schedule.status[id] = UNDECIDED;
+    }
+    std::shuffle(begin(profile->sessionCards), end(profile->sessionCards), profile->rng);
+    profile->active_set.assign(profile->sessionCards);
+}
+
+// Weighted sessions draw their first card before anything is shown
+void setSessionWeighted(bool weighted) {
+    profile->weightedSession = weighted;
+    if (weighted) {
+        buildPracticeSampler();
+        drawNextCard(AliasSampler::NONE); // nothing answered yet to hold back
+    }
+}
+
+// Queues the finished session's cards again, reshuffled, with the same fields. They are all
+// in inactive_set by now; the queue itself is empty and can't be shown as it is.
+void restartSession() {
+    profile->sessionCards.assign(profile->inactive_set.begin(), profile->inactive_set.end());
+    profile->inactive_set.clear();
+    beginSession();
+    setSessionWeighted(profile->weightedSession);
+    profile->currentCard = 0;
+    profile->currentPage = profile->active_set.empty() ? LESSON_SELECTION : SHOW_FLASHCARD;
+    profile->sessionChanged = true;
+}
+
+// Shuffles the cards gathered into sessionCards and moves on to choosing fields
+void startSession() {
+    beginSession();
+    if (profile->active_set.size() != 0) {
+        prefetchSessionGlyphs();
+        profile->currentPage = FLASHCARD_SELECTION;
+    }
+}
+
+// Queues the session for writing, or removes the file once there is nothing left to resume
+void saveSession() {
+    profile->sessionChanged = false;
+    profile->reviewLog.flush();
+    if (!sessionSnapshots) {
+        return;
+    }
+    if (profile->active_set.empty()) {
+        profile->snapshotWriter.discard();
+        return;
+    }
+    profile->sessionSnapshot.libraryCards = cardStore.size();
+    profile->sessionSnapshot.lessonCount = (uint32_t)lessonInfo.size();
+    profile->sessionSnapshot.fields = (uint8_t)profile->fields;
+    profile->sessionSnapshot.typedAnswers = profile->typedAnswers;
+    profile->sessionSnapshot.weighted = profile->weightedSession;
+    profile->active_set.copyTo(profile->sessionSnapshot.active);
+    profile->sessionSnapshot.inactive.assign(profile->inactive_set.begin(), profile->inactive_set.end());
+    profile->sessionSnapshot.status.clear();
+    for (const std::vector<CardId>* ids : { &profile->sessionSnapshot.active, &profile->sessionSnapshot.inactive }) {
+        for (CardId id : *ids) {
+            profile->sessionSnapshot.status.push_back(profile->schedule.status[id]);
+        }
+    }
+    profile->snapshotWriter.submit(profile->sessionSnapshot);
+}
+
+// Offered on the lesson page when the last run ended mid-session on this same library
+void loadResumableSession() {
+    profile->canResume = sessionSnapshots && loadSessionSnapshot(profile->sessionPath.c_str(), profile->resumableSession)
+        && profile->resumableSession.libraryCards == cardStore.size()
+        && profile->resumableSession.lessonCount == lessonInfo.size()
+        && !profile->resumableSession.active.empty();
+}
+
+// Picks up exactly where the snapshot left off: same order, same statuses, no shuffle
+void resumeSession() {
+    profile->active_set.assign(profile->resumableSession.active);
+    profile->inactive_set.swap(profile->resumableSession.inactive);
+    size_t i = 0;
+    for (const std::vector<CardId>* ids : { &profile->resumableSession.active, &profile->inactive_set }) {
+        for (CardId id : *ids) {
+            profile->schedule.status[id] = profile->resumableSession.status[i++];
+        }
+    }
+    profile->fields = profile->resumableSession.fields;
+    profile->typedAnswers = profile->resumableSession.typedAnswers != 0;
+    profile->weightedSession = profile->resumableSession.weighted != 0;
+    if (profile->weightedSession) {
+        profile->sessionCards = profile->resumableSession.active;
+        profile->sessionCards.insert(profile->sessionCards.end(), profile->inactive_set.begin(), profile->inactive_set.end());
+        buildPracticeSampler();
+    }
+    clearTypedAnswer();
+    profile->answerHistory.clear();
+    profile->canResume = false;
+    profile->currentCard = 0;
+    profile->currentPage = SHOW_FLASHCARD;
+}
+
+// The first profile keeps 'base'; "anna" saves to session-anna.bin beside it, with anything
+// but letters and digits in the name replaced
+std::string profileFilePath(const char* base, const std::string& name, bool first) {
+    if (first) {
+        return base;
+    }
+    fs::path path = base;
+    std::string stem = path.stem().string() + "-";
+    for (char c : name) {
+        stem += isalnum((unsigned char)c) || c == '-' || c == '_' ? c : '_';
+    }
+    return path.replace_filename(stem + path.extension().string()).string();
+}
+
+Profile* findProfile(const char* name) {
+    for (Profile& candidate : profiles) {
+        if (candidate.name == name) {
+            return &candidate;
+        }
+    }
+    return nullptr;
+}
+
+// Makes a profile with every card new and switches to it, offering its unfinished session
+// if it had one
+void addProfile(const char* name) {
+    profile = &profiles.emplace_back();
+    profile->name = name;
+    bool first = profiles.size() == 1;
+    profile->sessionPath = profileFilePath(sessionSnapshotPath, profile->name, first);
+    profile->schedule.reset(cardStore.size());
+    std::string logPath = profileFilePath(reviewLogPath, profile->name, first);
+    if (!profile->reviewLog.open(sessionSnapshots ? logPath.c_str() : nullptr, installId)) {
+        printf("Error: could not open review log %s\n", logPath.c_str());
+    }
+    profile->reviewLog.replay(profile->schedule);
+    profile->lessonSelected.assign(lessonInfo.size(), 0);
+    profile->rng.seed(rngSeed + (unsigned int)(profiles.size() - 1));
+    if (sessionSnapshots) {
+        profile->snapshotWriter.start(profile->sessionPath.c_str());
+        loadResumableSession();
+    }
+}
+
+void saveProfiles() {
+    if (!sessionSnapshots) {
+        return;
+    }
+    std::ofstream file(profilesPath);
+    for (const Profile& saved : profiles) {
+        file << saved.name << "\n";
+    }
+}
+
+// This install's id from installIdPath, made up and kept the first time. Runs that keep
+// nothing (replays) derive it from the seed instead, so they come out the same every time.
+void loadInstallId() {
+    if (!sessionSnapshots) {
+        installId = std::mt19937_64(rngSeed)();
+        return;
+    }
+    std::ifstream in(installIdPath);
+    if (in >> std::hex >> installId && installId != 0) {
+        return;
+    }
+    std::random_device random;
+    installId = (uint64_t)random() << 32 | random();
+    std::ofstream out(installIdPath);
+    out << std::hex << installId << "\n";
+}
+
+// The profiles from profilesPath, or just "default" the first time
+void loadProfiles() {
+    loadInstallId();
+    if (sessionSnapshots) {
+        std::ifstream file(profilesPath);
+        std::string name;
+        while (std::getline(file, name)) {
+            if (!name.empty() && !findProfile(name.c_str())) {
+                addProfile(name.c_str());
+            }
+        }
+    }
+    if (profiles.empty()) {
+        addProfile("default");
+    }
+    Profile* start = &profiles.front();
+    if (startProfile) {
+        start = findProfile(startProfile);
+        if (!start) {
+            addProfile(startProfile);
+            saveProfiles();
+            start = profile;
+        }
+    }
+    profile = start;
+}
+
+void switchProfile(Profile* next) {
+    profile = next;
+    browserResort = true;
+}
+
+// Who is studying, and a way to add someone; on the lesson page, where nobody's session is on show
+void showProfiles() {
+    ImGui::SetNextItemWidth(150.0f);
+    if (ImGui::BeginCombo("##profile", profile->name.c_str())) {
+        for (Profile& candidate : profiles) {
+            if (ImGui::Selectable(candidate.name.c_str(), &candidate == profile)) {
+                switchProfile(&candidate);
+            }
+        }
+        ImGui::EndCombo();
+    }
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(150.0f);
+    bool add = ImGui::InputTextWithHint("##newProfile", "New profile", newProfileName, IM_ARRAYSIZE(newProfileName), ImGuiInputTextFlags_EnterReturnsTrue);
+    ImGui::SameLine(); add |= ImGui::Button("Add profile");
+    if (add && newProfileName[0] && !findProfile(newProfileName)) {
+        addProfile(newProfileName);
+        saveProfiles();
+        browserResort = true;
+        newProfileName[0] = '\0';
+    }
+}
+
+void setLessonSelected(int lesson, bool selected) {
+    if ((profile->lessonSelected[lesson] != 0) == selected) {
+        return;
+    }
+    profile->lessonSelected[lesson] = selected;
+    int sign = selected ? 1 : -1;
+    profile->selectedLessonCount += sign;
+    profile->selectedCardCount += sign * lessonInfo[lesson].cardCount;
+}
+
+void setAllLessonsSelected(bool selected) {
+    for (int i = 0; i < (int)lessonInfo.size(); i++) {
+        setLessonSelected(i, selected);
+    }
+}
+
 void showLessonSelection() {
-    static bool selectableLessons[18];
-    if (ImGui::BeginTable("split", 3))
+    const int columns = 3;
+    int lessonCount = (int)lessonInfo.size();
+    int rows = (lessonCount + columns - 1) / columns;
+
+    showProfiles();
+    if (ImGui::Button("Select all")) setAllLessonsSelected(true);
+    ImGui::SameLine(); if (ImGui::Button("Select none")) setAllLessonsSelected(false);
+    ImGui::SameLine(); ImGui::Text("%d lessons, %d cards selected", profile->selectedLessonCount, profile->selectedCardCount);
+
+    // Only the visible rows are submitted, so frame cost doesn't grow with the catalogue
+    ImVec2 outerSize(0.0f, -ImGui::GetFrameHeightWithSpacing());
+    if (ImGui::BeginTable("lessons", columns, ImGuiTableFlags_ScrollY, outerSize))
     {
-        for (int i = 1; i <= lessons.size(); i++) {
-            char lessonText[10];
-            sprintf(lessonText, "Lesson %d", i);
-            ImGui::TableNextColumn(); ImGui::Checkbox(lessonText, selectableLessons + (i-1));
+        ImGuiListClipper clipper;
+        clipper.Begin(rows);
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                ImGui::TableNextRow();
+                for (int i = row * columns; i < lessonCount && i < (row + 1) * columns; i++) {
+                    ImGui::TableNextColumn();
+                    bool selected = profile->lessonSelected[i] != 0;
+                    ImGui::PushID(i);
+                    if (ImGui::Checkbox(lessonInfo[i].label.c_str(), &selected)) {
+                        // shift-click applies the new state to everything since the last click
+                        if (io->KeyShift && profile->lastClickedLesson >= 0) {
+                            int first = std::min(profile->lastClickedLesson, i);
+                            int last = std::max(profile->lastClickedLesson, i);
+                            for (int j = first; j <= last; j++) {
+                                setLessonSelected(j, selected);
+                            }
+                        } else {
+                            setLessonSelected(i, selected);
+                        }
+                        profile->lastClickedLesson = i;
+                    }
+                    ImGui::PopID();
+                }
+            }
         }
         ImGui::EndTable();
     }
     if(ImGui::Button("Next")) {
-        active_set.clear();
-        inactive_set.clear();
-        for (int i = 0; i <= lessons.size(); i++) {
-            if (selectableLessons[i]) {
-                active_set.insert(end(active_set), begin(lessons[i]), end(lessons[i]));
+        profile->sessionCards.clear();
+        profile->inactive_set.clear();
+        profile->sessionCards.reserve(profile->selectedCardCount);
+        for (int i = 0; i < lessonCount; i++) {
+            if (profile->lessonSelected[i]) {
+                for (int card = 0; card < lessonInfo[i].cardCount; card++) {
+                    profile->sessionCards.push_back(lessonInfo[i].firstCard + card);
+                }
             }
         }
-        if (active_set.size() != 0) {
-            std::shuffle(begin(active_set), end(active_set), rng);
-            currentPage = FLASHCARD_SELECTION;
+        startSession();
+    }
+    ImGui::SameLine(); if (ImGui::Button("Browse cards")) {
+        profile->currentPage = CARD_BROWSER;
+    }
+    ImGui::SameLine(); if (ImGui::Button("Statistics")) {
+        profile->currentPage = STATISTICS;
+    }
+    if (profile->canResume) {
+        ImGui::SameLine(); if (ImGui::Button("Resume session")) {
+            resumeSession();
         }
+        ImGui::SameLine(); ImGui::Text("%lu cards left", profile->resumableSession.active.size());
     }
 }
 
 void showFlashcardSelection() {
-    static bool en = false;
-    static bool cn = false;
-    static bool py = false;
     if(ImGui::Button("Return to menu")) {
-        currentPage = LESSON_SELECTION;
+        profile->currentPage = LESSON_SELECTION;
+    }
+    ImGui::Checkbox("English", &profile->showEnglish);
+    ImGui::Checkbox("Chinese", &profile->showChinese);
+    ImGui::Checkbox("Pinyin", &profile->showPinyin);
+    bool typable = canTypeAnswer((profile->showEnglish ? ENGLISH : 0) | (profile->showPinyin ? PINYIN : 0));
+    ImGui::BeginDisabled(!typable);
+    ImGui::Checkbox("Type answers", &profile->typedAnswers);
+    ImGui::EndDisabled();
+    if (!typable && ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+        ImGui::SetTooltip("English and pinyin are both shown, so there's nothing to type");
+    }
+    ImGui::BeginDisabled(!confusablesReady);
+    ImGui::Checkbox("Practice look-alikes together", &profile->groupConfusables);
+    ImGui::EndDisabled();
+    if (!confusablesReady) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("(finding look-alikes...)");
     }
-    ImGui::Checkbox("English", &en);
-    ImGui::Checkbox("Chinese", &cn);
-    ImGui::Checkbox("Pinyin", &py);
+    ImGui::Checkbox("Weight by difficulty", &profile->weightedPractice);
     if(ImGui::Button("Next")) {
-        fields  = 0;
-        if (en || cn || py) {
+        profile->fields  = 0;
+        if (profile->showEnglish || profile->showChinese || profile->showPinyin) {
             // user must select something to advance
 
-            if (en) fields |= ENGLISH;
-            if (cn) fields |= CHINESE;
-            if (py) fields |= PINYIN;
-            currentPage = SHOW_FLASHCARD;
-            currentCard = 0;
+            if (profile->showEnglish) profile->fields |= ENGLISH;
+            if (profile->showChinese) profile->fields |= CHINESE;
+            if (profile->showPinyin) profile->fields |= PINYIN;
+            if (profile->groupConfusables && confusablesReady) groupConfusableCards();
+            setSessionWeighted(profile->weightedPractice);
+            profile->currentPage = SHOW_FLASHCARD;
+            profile->currentCard = 0;
+            profile->canResume = false;
+            profile->sessionChanged = true;
         }
     }
 }
 
 void showFlashcard(){
     if(ImGui::Button("Return to menu")) {
-        currentPage = LESSON_SELECTION;
+        profile->currentPage = LESSON_SELECTION;
+    }
+    CardId card = profile->active_set.front();
+    if (profile->typedAnswers && canTypeAnswer(profile->fields)) {
+        bool pinyin;
+        std::string_view expected = expectedAnswer(card, &pinyin);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(-FLT_MIN);
+        if (!ImGui::IsAnyItemActive()) {
+            ImGui::SetKeyboardFocusHere();
+        }
+        if (ImGui::InputTextWithHint("##answer", pinyin ? "Type the pinyin" : "Type the English",
+                                     profile->typedAnswer, IM_ARRAYSIZE(profile->typedAnswer), ImGuiInputTextFlags_EnterReturnsTrue)) {
+            profile->typedGrade = gradeAnswer(profile->typedAnswer, expected, pinyin);
+            profile->typedGraded = true;
+            flipCard();
+        }
     }
-    Flashcard card = active_set.front();
     ImGui::PushFont(cn_large);
-    if (fields & ENGLISH) TextCentered(card.english);
-    if (fields & PINYIN) TextCentered(card.pinyin);
-    if (fields & CHINESE) TextCentered(card.chinese);
+    if (profile->fields & ENGLISH) TextCentered(cardStore.english(card));
+    if (profile->fields & PINYIN) TextCentered(cardStore.pinyin(card));
+    if (profile->fields & CHINESE) TextCentered(cardStore.chinese(card));
     ImGui::PopFont();
     skipInvisibleFlashcardFields();
     if (ImGui::BeginTable("split", 3)) {
         ImGui::TableNextColumn(); if (ImGui::Button("Previous")) {
-            if (inactive_set.size() != 0) {
-                Flashcard prevCard = inactive_set.back();
-                if (prevCard.status = CORRECT) {
-                    prevCard.status = UNDECIDED;
-                }
-                active_set.insert(begin(active_set), prevCard);
-                inactive_set.pop_back();
+            if (profile->answerHistory.canUndo()) {
+                undoAnswer();
+            }
+        }
+        if (profile->answerHistory.canRedo()) {
+            ImGui::SameLine(); if (ImGui::Button("Redo")) {
+                redoAnswer();
             }
         }
         ImGui::TableNextColumn(); if(ImGui::Button("Flip")) {
-            currentPage = REVEAL_FLASHCARD;
+            flipCard();
         }
         ImGui::TableNextColumn(); if(ImGui::Button("Next")) {
-            if (card.status != INCORRECT) {
-                card.status = CORRECT;
-            }
-            inactive_set.push_back(card);
-            active_set.erase(begin(active_set));
-            if (active_set.size() == 0) {
-                currentPage = SHOW_RESULTS;
-            }
+            answerCorrect();
         }
         ImGui::EndTable();
     }
+    // after the buttons, so an answer queues the new upcoming cards this frame
+    prefetchUpcomingCards();
 }
 
 void revealFlashcard() {
     if(ImGui::Button("Return to menu")) {
-        currentPage = LESSON_SELECTION;
+        profile->currentPage = LESSON_SELECTION;
+    }
+    if (pinyinAudio.enabled()) {
+        ImGui::SameLine();
+        if (ImGui::Button("Say again")) {
+            pinyinAudio.play(profile->active_set.front());
+        }
     }
-    Flashcard card = active_set.front();
+    if (profile->typedGraded) {
+        ImGui::SameLine();
+        if (profile->typedGrade.correct) {
+            ImGui::TextColored(ImVec4(0.4f, 0.9f, 0.4f, 1.0f), profile->typedGrade.distance == 0 ? "Correct" : "Correct (%d typo%s)",
+                               profile->typedGrade.distance, profile->typedGrade.distance == 1 ? "" : "s");
+        } else {
+            ImGui::TextColored(ImVec4(0.9f, 0.4f, 0.4f, 1.0f), "Incorrect: %s", profile->typedAnswer);
+        }
+    }
+    CardId card = profile->active_set.front();
     ImGui::PushFont(cn_large);
-    TextCentered(card.english);
-    TextCentered(card.pinyin);
-    TextCentered(card.chinese);
+    TextCentered(cardStore.english(card));
+    TextCentered(cardStore.pinyin(card));
+    TextCentered(cardStore.chinese(card));
     ImGui::PopFont();
     if (ImGui::BeginTable("split", 2)) {
         ImGui::TableNextColumn(); if(ImGui::Button("Incorrect")){
-            card.status = INCORRECT;
-            active_set.erase(begin(active_set));
-            int num_left = active_set.size();
-            if (num_left <= 3) {
-                active_set.push_back(card);
-            } else {
-                std::uniform_int_distribution<> distr(3, num_left-1);
-                active_set.insert(begin(active_set) + distr(rng), card);
-            }
-
-
-            if (active_set.size() == 0) {
-                currentPage = SHOW_RESULTS;
-            } else {
-                currentPage = SHOW_FLASHCARD;
-            }
+            answerIncorrect();
         }
         ImGui::TableNextColumn(); if(ImGui::Button("Correct")){
-            if (card.status != INCORRECT) {
-                card.status = CORRECT;
-            }
-            inactive_set.push_back(card);
-            active_set.erase(begin(active_set));
-            if (active_set.size() == 0) {
-                currentPage = SHOW_RESULTS;
-            } else {
-                currentPage = SHOW_FLASHCARD;
-            }
+            answerCorrect();
         }
         ImGui::EndTable();
     }
+    // Enter takes the automatic grade; the buttons above override it
+    if (profile->typedGraded && profile->currentPage == REVEAL_FLASHCARD && ImGui::IsKeyPressed(ImGuiKey_Enter, false)) {
+        if (profile->typedGrade.correct) {
+            answerCorrect();
+        } else {
+            answerIncorrect();
+        }
+    }
+    // after the buttons, so an answer queues the new upcoming cards this frame
+    prefetchUpcomingCards();
 }
 
 void showResults() {
     int numCorrect = 0;
-    for (auto& card : inactive_set) {
-        numCorrect += card.status == CORRECT;
+    for (CardId id : profile->inactive_set) {
+        numCorrect += profile->schedule.status[id] == CORRECT;
     }
-    ImGui::Text("%d/%lu correct", numCorrect, inactive_set.size());
+    ImGui::Text("%d/%lu correct", numCorrect, profile->inactive_set.size());
     if (ImGui::BeginTable("split", 2)) {
         ImGui::TableNextColumn(); if(ImGui::Button("Restart lesson")) {
-            currentCard = 0;
-            currentPage = SHOW_FLASHCARD;
+            restartSession();
         }
         ImGui::TableNextColumn(); if(ImGui::Button("Back to menu")) {
-            currentPage = LESSON_SELECTION;
+            profile->currentPage = LESSON_SELECTION;
         };
         ImGui::EndTable();
     }
 }
 
+typedef enum BrowserColumn {
+    BROWSER_ENGLISH,
+    BROWSER_PINYIN,
+    BROWSER_CHINESE,
+    BROWSER_LESSON,
+    BROWSER_STATUS,
+    BROWSER_DUE
+} BrowserColumn;
+
+const char* statusName(uint8_t status) {
+    switch (status) {
+    case CORRECT: return "correct";
+    case INCORRECT: return "incorrect";
+    default: return "new";
+    }
+}
+
+// First 8 bytes, big-endian, so comparing keys agrees with comparing the strings
+uint64_t stringPrefixKey(std::string_view text) {
+    uint64_t key = 0;
+    for (size_t i = 0; i < 8; i++) {
+        key = key << 8 | (i < text.size() ? (unsigned char)text[i] : 0);
+    }
+    return key;
+}
+
+// Replaces each card's text in one column by its rank among the distinct strings of that column,
+// so sorting compares integers instead of chasing string pointers
+void rankBrowserColumn(int column, CardText field) {
+    auto text = [field](const BrowserSortKey& item) { return cardStore.text(field, item.card); };
+    browserKeys.resize(cardStore.size());
+    for (uint32_t i = 0; i < browserKeys.size(); i++) {
+        browserKeys[i].key = stringPrefixKey(cardStore.text(field, i));
+        browserKeys[i].card = i;
+    }
+    parallelRadixSort(browserKeys, browserKeysScratch, [](const BrowserSortKey& item) { return item.key; });
+
+    // equal prefixes are only ambiguous when the strings are longer than the prefix
+    for (size_t first = 0; first < browserKeys.size();) {
+        size_t last = first + 1;
+        while (last < browserKeys.size() && browserKeys[last].key == browserKeys[first].key) {
+            last++;
+        }
+        if (last - first > 1 && text(browserKeys[first]).size() >= 8) {
+            std::sort(browserKeys.begin() + first, browserKeys.begin() + last, [&](const BrowserSortKey& a, const BrowserSortKey& b) {
+                return text(a) < text(b);
+            });
+        }
+        first = last;
+    }
+
+    std::vector<uint32_t>& ranks = browserRanks[column];
+    ranks.resize(cardStore.size());
+    uint32_t rank = 0;
+    for (size_t i = 0; i < browserKeys.size(); i++) {
+        if (i > 0 && (browserKeys[i].key != browserKeys[i - 1].key || text(browserKeys[i]) != text(browserKeys[i - 1]))) {
+            rank++;
+        }
+        ranks[browserKeys[i].card] = rank;
+    }
+    browserRankCount[column] = browserKeys.empty() ? 0 : rank + 1;
+}
+
+// Called once after loading
+void buildCardBrowser() {
+    browserOrder.resize(cardStore.size());
+    for (uint32_t i = 0; i < browserOrder.size(); i++) {
+        browserOrder[i] = i;
+    }
+    rankBrowserColumn(BROWSER_ENGLISH, CARD_ENGLISH);
+    rankBrowserColumn(BROWSER_PINYIN, CARD_PINYIN);
+    rankBrowserColumn(BROWSER_CHINESE, CARD_CHINESE);
+}
+
+uint32_t browserValue(uint32_t card, int column) {
+    switch (column) {
+    case BROWSER_ENGLISH:
+    case BROWSER_PINYIN:
+    case BROWSER_CHINESE:
+        return browserRanks[column][card];
+    case BROWSER_LESSON: return cardStore.lesson(card);
+    case BROWSER_STATUS: return profile->schedule.status[card];
+    case BROWSER_DUE: return profile->schedule.due[card];
+    }
+    return 0;
+}
+
+uint32_t browserMaxValue(int column) {
+    switch (column) {
+    case BROWSER_ENGLISH:
+    case BROWSER_PINYIN:
+    case BROWSER_CHINESE:
+        return browserRankCount[column] ? browserRankCount[column] - 1 : 0;
+    case BROWSER_LESSON: return lessonInfo.size() ? (uint32_t)lessonInfo.size() - 1 : 0;
+    case BROWSER_STATUS: return UNDECIDED;
+    case BROWSER_DUE: return profile->schedule.due.empty() ? 0 : *std::max_element(profile->schedule.due.begin(), profile->schedule.due.end());
+    }
+    return 0;
+}
+
+// The sort columns are packed, most significant first, into one 64-bit key per card, and
+// the (key, card) pairs are radix sorted; being stable, ties keep library order. Columns that
+// don't fit in the key are resolved afterwards within runs of equal keys.
+void sortCardBrowser(const ImGuiTableSortSpecs* specs) {
+    int packedColumns = 0;
+    int shifts[BROWSER_DUE + 1] = {};
+    uint32_t maxValues[BROWSER_DUE + 1] = {}; // once per column, since Due's scans every card
+    int totalBits = 0;
+    for (; packedColumns < specs->SpecsCount && packedColumns < IM_ARRAYSIZE(shifts); packedColumns++) {
+        maxValues[packedColumns] = browserMaxValue(specs->Specs[packedColumns].ColumnUserID);
+        int bits = 0;
+        for (uint32_t max = maxValues[packedColumns]; max; max >>= 1) {
+            bits++;
+        }
+        if (totalBits + bits > 64) {
+            break;
+        }
+        shifts[packedColumns] = bits;
+        totalBits += bits;
+    }
+
+    browserKeys.resize(cardStore.size());
+    for (uint32_t i = 0; i < browserKeys.size(); i++) {
+        uint64_t key = 0;
+        for (int c = 0; c < packedColumns; c++) {
+            const ImGuiTableColumnSortSpecs& spec = specs->Specs[c];
+            uint32_t value = browserValue(i, spec.ColumnUserID);
+            if (spec.SortDirection == ImGuiSortDirection_Descending) {
+                value = maxValues[c] - value;
+            }
+            key = key << shifts[c] | value;
+        }
+        browserKeys[i].key = key;
+        browserKeys[i].card = i;
+    }
+    parallelRadixSort(browserKeys, browserKeysScratch, [](const BrowserSortKey& item) { return item.key; });
+    for (size_t i = 0; i < browserKeys.size(); i++) {
+        browserOrder[i] = browserKeys[i].card;
+    }
+
+    if (packedColumns == specs->SpecsCount) {
+        return;
+    }
+    auto compare = [specs](uint32_t a, uint32_t b) {
+        for (int i = 0; i < specs->SpecsCount; i++) {
+            const ImGuiTableColumnSortSpecs& spec = specs->Specs[i];
+            uint32_t x = browserValue(a, spec.ColumnUserID);
+            uint32_t y = browserValue(b, spec.ColumnUserID);
+            if (x != y) {
+                return spec.SortDirection == ImGuiSortDirection_Ascending ? x < y : x > y;
+            }
+        }
+        return a < b;
+    };
+    for (size_t first = 0; first < browserKeys.size();) {
+        size_t last = first + 1;
+        while (last < browserKeys.size() && browserKeys[last].key == browserKeys[first].key) {
+            last++;
+        }
+        if (last - first > 1) {
+            std::sort(browserOrder.begin() + first, browserOrder.begin() + last, compare);
+        }
+        first = last;
+    }
+}
+
+// Cards whose English, pinyin or characters match; "jintian", "jin1tian1", "jīntiān"
+// and "今" all find 今天, and "年|月" finds cards with either character
+void searchCardBrowser() {
+    browserFiltered = englishIndex.search(browserQuery, browserMatches);
+    browserMatchSet.reset(cardStore.size());
+    for (uint32_t id : browserMatches) {
+        browserMatchSet.insert(id);
+    }
+    browserFiltered |= pinyinIndex.search(browserQuery, browserMatchSet);
+    browserFiltered |= hanziIndex.search(browserQuery, browserMatchSet);
+}
+
+// Keeps the matches in the current sort order, so sorting and searching compose
+void filterCardBrowser() {
+    browserRows.clear();
+    if (!browserFiltered) {
+        return;
+    }
+    for (uint32_t id : browserOrder) {
+        if (browserMatchSet.contains(id)) {
+            browserRows.push_back(id);
+        }
+    }
+}
+
+void showCardBrowser() {
+    if(ImGui::Button("Return to menu")) {
+        profile->currentPage = LESSON_SELECTION;
+    }
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(200.0f);
+    if (ImGui::InputTextWithHint("##search", "Search English, pinyin or hanzi", browserQuery, IM_ARRAYSIZE(browserQuery))) {
+        searchCardBrowser();
+        filterCardBrowser();
+    }
+    const std::vector<uint32_t>& rows = browserFiltered ? browserRows : browserOrder;
+    ImGui::SameLine(); ImGui::Text("%lu cards", rows.size());
+    // drill the search results across every lesson, e.g. all the words with one character
+    if (browserFiltered && rows.size() != 0) {
+        ImGui::SameLine(); if (ImGui::Button("Drill")) {
+            profile->sessionCards.assign(rows.begin(), rows.end());
+            profile->inactive_set.clear();
+            startSession();
+        }
+    }
+
+    ImGuiTableFlags flags =
+        ImGuiTableFlags_Sortable |
+        ImGuiTableFlags_SortMulti |
+        ImGuiTableFlags_ScrollY |
+        ImGuiTableFlags_RowBg |
+        ImGuiTableFlags_BordersOuter |
+        ImGuiTableFlags_BordersV |
+        ImGuiTableFlags_Resizable;
+    if (!ImGui::BeginTable("cards", 6, flags)) {
+        return;
+    }
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("English", ImGuiTableColumnFlags_WidthStretch, 0.0f, BROWSER_ENGLISH);
+    ImGui::TableSetupColumn("Pinyin", ImGuiTableColumnFlags_WidthStretch, 0.0f, BROWSER_PINYIN);
+    ImGui::TableSetupColumn("Chinese", ImGuiTableColumnFlags_WidthStretch, 0.0f, BROWSER_CHINESE);
+    ImGui::TableSetupColumn("Lesson", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_DefaultSort, 0.0f, BROWSER_LESSON);
+    ImGui::TableSetupColumn("Status", ImGuiTableColumnFlags_WidthFixed, 0.0f, BROWSER_STATUS);
+    ImGui::TableSetupColumn("Due", ImGuiTableColumnFlags_WidthFixed, 0.0f, BROWSER_DUE);
+    ImGui::TableHeadersRow();
+
+    if (ImGuiTableSortSpecs* specs = ImGui::TableGetSortSpecs()) {
+        if (specs->SpecsDirty || browserResort) {
+            sortCardBrowser(specs);
+            filterCardBrowser();
+            specs->SpecsDirty = false;
+            browserResort = false;
+        }
+    }
+
+    // Chinese is drawn with the large font scaled down, rather than baking a second CJK atlas
+    float chineseScale = ImGui::GetFontSize() / large_font_size;
+    uint32_t today = currentDay();
+    ImGuiListClipper clipper;
+    clipper.Begin((int)rows.size());
+    while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+            CardId card = rows[row];
+            std::string_view english = cardStore.english(card);
+            std::string_view pinyin = cardStore.pinyin(card);
+            std::string_view chinese = cardStore.chinese(card);
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(english.data(), english.data() + english.size());
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(pinyin.data(), pinyin.data() + pinyin.size());
+            ImGui::TableNextColumn();
+            ImGui::PushFont(cn_large);
+            ImGui::SetWindowFontScale(chineseScale);
+            ImGui::TextUnformatted(chinese.data(), chinese.data() + chinese.size());
+            ImGui::SetWindowFontScale(1.0f);
+            ImGui::PopFont();
+            ImGui::TableNextColumn(); ImGui::Text("%u", cardStore.lesson(card) + 1);
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(statusName(profile->schedule.status[card]));
+            ImGui::TableNextColumn();
+            if (profile->schedule.due[card] <= today) {
+                ImGui::TextUnformatted("now");
+            } else {
+                ImGui::Text("in %ud", profile->schedule.due[card] - today);
+            }
+        }
+    }
+    ImGui::EndTable();
+}
+
+// Lessons are consecutive id ranges, so each lesson's figures are one kernel call over its
+// slice of the columns and the library totals are their sum
+void updateStats() {
+    Uint64 start = SDL_GetPerformanceCounter();
+    uint32_t today = currentDay();
+    lessonStats.resize(lessonInfo.size());
+    libraryStats = CardStats{};
+    for (size_t i = 0; i < lessonInfo.size(); i++) {
+        lessonStats[i] = CardStats{};
+        addCardStats(profile->schedule, lessonInfo[i].firstCard, lessonInfo[i].firstCard + lessonInfo[i].cardCount, today, lessonStats[i]);
+        addCardStats(lessonStats[i], libraryStats);
+    }
+    statsMs = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+// Share of answered cards that were answered correctly, as a percentage
+double accuracy(const CardStats& stats) {
+    uint64_t answered = stats.status[CORRECT] + stats.status[INCORRECT];
+    return answered ? 100.0 * stats.status[CORRECT] / answered : 0.0;
+}
+
+void showStatistics() {
+    updateStats();
+    if(ImGui::Button("Return to menu")) {
+        profile->currentPage = LESSON_SELECTION;
+    }
+    ImGui::SameLine();
+    ImGui::Text("%llu cards, %llu due, %llu new (%.3f ms)", (unsigned long long)libraryStats.cards,
+        (unsigned long long)libraryStats.due, (unsigned long long)libraryStats.unseen, statsMs);
+    ImGui::Text("Correct %llu, incorrect %llu (%.0f%%), %llu lapses", (unsigned long long)libraryStats.status[CORRECT],
+        (unsigned long long)libraryStats.status[INCORRECT], accuracy(libraryStats), (unsigned long long)libraryStats.lapses);
+
+    if (ImGui::BeginTable("intervals", INTERVAL_BUCKETS, ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_NoSavedSettings)) {
+        for (int i = 0; i < INTERVAL_BUCKETS; i++) {
+            ImGui::TableSetupColumn(intervalBucketNames[i]);
+        }
+        ImGui::TableHeadersRow();
+        ImGui::TableNextRow();
+        for (int i = 0; i < INTERVAL_BUCKETS; i++) {
+            ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)libraryStats.intervals[i]);
+        }
+        ImGui::EndTable();
+    }
+
+    ImGuiTableFlags flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersV | ImGuiTableFlags_NoSavedSettings;
+    if (!ImGui::BeginTable("lessonStats", 6, flags)) {
+        return;
+    }
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("Lesson");
+    ImGui::TableSetupColumn("Cards");
+    ImGui::TableSetupColumn("Correct");
+    ImGui::TableSetupColumn("Incorrect");
+    ImGui::TableSetupColumn("Due");
+    ImGui::TableSetupColumn("New");
+    ImGui::TableHeadersRow();
+    ImGuiListClipper clipper;
+    clipper.Begin((int)lessonStats.size());
+    while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+            const CardStats& stats = lessonStats[row];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::Text("%d", row + 1);
+            ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)stats.cards);
+            ImGui::TableNextColumn(); ImGui::Text("%llu (%.0f%%)", (unsigned long long)stats.status[CORRECT], accuracy(stats));
+            ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)stats.status[INCORRECT]);
+            ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)stats.due);
+            ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)stats.unseen);
+        }
+    }
+    ImGui::EndTable();
+}
+
+// Fills in what the dictionary knows, then adds the card to the store and every index
+void addLessonCard(std::string& english, std::string& pinyin, const std::string& chinese) {
+    dictionary.fill(chinese, pinyin, english);
+    CardId id = cardStore.add(english, pinyin, chinese, (uint32_t)lessonInfo.size());
+    englishIndex.addCard(id, english);
+    pinyinIndex.addCard(id, pinyin);
+    hanziIndex.addCard(id, chinese);
+    confusableIndex.addCard(id, english, pinyin, chinese);
+}
+
 void push_lesson(int lessonNumber) {
-    std::vector<Flashcard> lesson;
-    std::stringstream pathstream;
-    pathstream << "lessons/lesson" << lessonNumber << ".csv";
-    std::ifstream file(pathstream.str());
-    std::string line;
-    file.ignore(3); // seems to not like the first 3 bytes
-    while (std::getline(file, line)) {
-        Flashcard card;
-        std::stringstream lineStream(line);
-        std::string cell;
-        
-        std::getline(lineStream, cell, ',');
-        card.english = cell;
-        std::getline(lineStream, cell, ',');
-        card.pinyin = cell;
-        std::getline(lineStream, cell, ',');
-        card.chinese = cell;
-        lesson.push_back(card);
-    }
-
-    lessons.push_back(lesson);
+    std::string path = "lessons/lesson" + std::to_string(lessonNumber);
+    LessonInfo info;
+    info.firstCard = cardStore.size();
+    std::string english;
+    std::string pinyin;
+    std::string chinese;
+    DeckReader deck;
+    if (deck.open((path + ".deck").c_str())) {
+        std::string_view cells[3];
+        while (deck.next(cells[CARD_ENGLISH], cells[CARD_PINYIN], cells[CARD_CHINESE])) {
+            english = cells[CARD_ENGLISH];
+            pinyin = cells[CARD_PINYIN];
+            chinese = cells[CARD_CHINESE];
+            addLessonCard(english, pinyin, chinese);
+        }
+    } else {
+        std::ifstream file(path + ".csv");
+        std::string line;
+        file.ignore(3); // seems to not like the first 3 bytes
+        while (std::getline(file, line)) {
+            std::stringstream lineStream(line);
+            std::string cell;
+
+            std::getline(lineStream, cell, ',');
+            english = cell;
+            std::getline(lineStream, cell, ',');
+            pinyin = cell;
+            std::getline(lineStream, cell, ',');
+            chinese = cell;
+            addLessonCard(english, pinyin, chinese);
+        }
+    }
+
+    info.cardCount = (int)(cardStore.size() - info.firstCard);
+    info.label = "Lesson " + std::to_string(lessonNumber) + " (" + std::to_string(info.cardCount) + " cards)";
+    lessonInfo.push_back(std::move(info));
 }
 
-// Main code
-int main(int, char**)
-{
-    if (setup() != 0) {
-        return -1;
+void showDebugOverlay() {
+    ImGuiWindowFlags window_flags =
+        ImGuiWindowFlags_NoDecoration |
+        ImGuiWindowFlags_AlwaysAutoResize |
+        ImGuiWindowFlags_NoSavedSettings |
+        ImGuiWindowFlags_NoFocusOnAppearing |
+        ImGuiWindowFlags_NoNav |
+        ImGuiWindowFlags_NoInputs;
+    ImGui::SetNextWindowPos(ImVec2(io->DisplaySize.x - 5.0f, 5.0f), ImGuiCond_Always, ImVec2(1.0f, 0.0f));
+    ImGui::SetNextWindowBgAlpha(0.6f);
+    ImGui::Begin("Debug overlay", nullptr, window_flags);
+    const AllocCounts& allocs = allocTracker.lastFrame();
+    ImGui::Text("%.3f ms/frame", lastFrameMs);
+    ImGui::Text("%.3f ms answer to next card", lastAnswerLatencyMs);
+    ImGui::Text("%llu allocs/frame, %llu bytes/frame", (unsigned long long)allocs.totalAllocations(), (unsigned long long)allocs.totalBytes());
+    for (int i = 0; i < ALLOC_SUBSYSTEM_COUNT; i++) {
+        if (allocs.allocations[i]) {
+            ImGui::Text("  %s: %llu (%llu bytes)", allocSubsystemName((AllocSubsystem)i), (unsigned long long)allocs.allocations[i], (unsigned long long)allocs.bytes[i]);
+        }
+    }
+    ImGui::End();
+}
+
+void parseArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            maxFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--screenshot") == 0 && i + 1 < argc) {
+            screenshotPath = argv[++i];
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            rngSeed = (unsigned int)strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--realtime") == 0) {
+            replay.setRealtime(true);
+        } else if (strcmp(argv[i], "--histogram") == 0 && i + 1 < argc) {
+            histogramPath = argv[++i];
+        } else if (strcmp(argv[i], "--overlay") == 0) {
+            showOverlay = true;
+        } else if (strcmp(argv[i], "--fail-on-alloc") == 0) {
+            failOnAlloc = true;
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            allocWarmupFrames = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--session") == 0 && i + 1 < argc) {
+            sessionSnapshotPath = argv[++i];
+            sessionPathGiven = true;
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            startProfile = argv[++i];
+        } else if (strcmp(argv[i], "--cedict") == 0 && i + 1 < argc) {
+            cedictPath = argv[++i];
+        } else if (strcmp(argv[i], "--make-deck") == 0 && i + 1 < argc) {
+            deckCorpusPath = argv[++i];
+        } else if (strcmp(argv[i], "--deck-size") == 0 && i + 1 < argc) {
+            deckSize = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--import") == 0 && i + 1 < argc) {
+            importPath = argv[++i];
+        } else if (strcmp(argv[i], "--fields") == 0 && i + 1 < argc) {
+            importFields = argv[++i];
+        } else if (strcmp(argv[i], "--packed") == 0) {
+            importPacked = true;
+        } else if (strcmp(argv[i], "--lesson-size") == 0 && i + 1 < argc) {
+            importLessonSize = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--audio-pack") == 0 && i + 1 < argc) {
+            audioPackPath = argv[++i];
+        } else if (strcmp(argv[i], "--make-audio-pack") == 0 && i + 1 < argc) {
+            audioPackDirectory = argv[++i];
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serveAddress = argv[++i];
+        } else if (strcmp(argv[i], "--sync") == 0 && i + 1 < argc) {
+            syncAddress = argv[++i];
+        } else if (strcmp(argv[i], "--load-test") == 0 && i + 1 < argc) {
+            loadTestAddress = argv[++i];
+        } else if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc) {
+            loadClients = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            loadBatch = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            loadSeconds = atof(argv[++i]);
+        } else {
+            printf("Unknown argument: %s\n", argv[i]);
+        }
     }
+}
 
+void loadLibrary() {
+    AllocScope loadingScope(ALLOC_LOADING);
+    dictionary.load(cedictPath.c_str(), (cedictPath + ".trie").c_str());
     std::string path = "lessons";
     int lessonNumber = 0;
     for (const auto & entry : fs::directory_iterator(path)) {
         push_lesson(++lessonNumber);
     }
-    
+    englishIndex.commit();
+    pinyinIndex.commit();
+    buildCardBrowser();
+    lessonStats.reserve(lessonInfo.size());
+}
+
+// Lesson CSV cells can't hold commas, since push_lesson() doesn't handle quoting
+std::string csvCell(const char* text) {
+    std::string cell = text;
+    std::replace(cell.begin(), cell.end(), ',', ';');
+    return cell;
+}
+
+// Segments the corpus and writes the deckSize most frequent words that no lesson has yet
+// as new lessons after the existing ones
+int makeDeck() {
+    if (!dictionary.loaded()) {
+        printf("Error: --make-deck needs the dictionary (%s)\n", cedictPath.c_str());
+        return 1;
+    }
+    Segmenter segmenter(dictionary);
+    Uint64 start = SDL_GetPerformanceCounter();
+    if (!segmenter.countFile(deckCorpusPath)) {
+        printf("Error: could not read corpus %s\n", deckCorpusPath);
+        return 1;
+    }
+    double seconds = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    double megabytes = segmenter.bytesCounted() / 1048576.0;
+    printf("Segmented %.1f MB in %.2f s (%.1f MB/s)\n", megabytes, seconds, megabytes / seconds);
+
+    std::unordered_set<std::string> known;
+    for (CardId id = 0; id < cardStore.size(); id++) {
+        known.insert(std::string(cardStore.chinese(id)));
+    }
+    const std::vector<uint64_t>& counts = segmenter.wordCounts();
+    std::vector<std::pair<uint64_t, uint32_t>> ranked; // count, word
+    for (uint32_t word = 0; word < counts.size(); word++) {
+        if (counts[word] > 0) {
+            ranked.emplace_back(counts[word], word);
+        }
+    }
+    std::sort(ranked.begin(), ranked.end(), [](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < ranked.size() && (int)lines.size() < deckSize; i++) {
+        std::string chinese = dictionary.headword(ranked[i].second);
+        if (known.count(chinese)) {
+            continue;
+        }
+        const uint32_t* ids;
+        dictionary.wordEntries(ranked[i].second, &ids);
+        const DictionaryEntry& entry = dictionary.entry(ids[0]);
+        lines.push_back(csvCell(entry.english) + "," + csvCell(entry.pinyin) + "," + chinese);
+    }
+
+    int firstLesson = (int)lessonInfo.size() + 1;
+    int lessonNumber = firstLesson;
+    for (size_t first = 0; first < lines.size(); first += deckLessonSize, lessonNumber++) {
+        std::string path = "lessons/lesson" + std::to_string(lessonNumber) + ".csv";
+        std::ofstream file(path, std::ios::binary);
+        file << "\xEF\xBB\xBF"; // push_lesson() skips a byte order mark
+        for (size_t i = first; i < first + deckLessonSize && i < lines.size(); i++) {
+            file << lines[i] << "\n";
+        }
+        if (!file) {
+            printf("Error: could not write %s\n", path.c_str());
+            return 1;
+        }
+    }
+    printf("Wrote %zu new words as lessons %d-%d\n", lines.size(), firstLesson, lessonNumber - 1);
+    return 0;
+}
+
+// Lesson files already in lessons/, which loadLibrary() numbers from 1 in the same way
+int countLessons() {
+    int count = 0;
+    std::error_code error;
+    for (fs::directory_iterator it("lessons", error), end; !error && it != end; it.increment(error)) {
+        count++;
+    }
+    return count;
+}
+
+// Packs the WAV files in audioPackDirectory into audioPackPath and checks it reads back
+int makeAudioPack() {
+    std::string error;
+    if (!writeClipPack(audioPackDirectory, audioPackPath, error)) {
+        printf("Error: %s\n", error.c_str());
+        return 1;
+    }
+    ClipPack pack;
+    if (!pack.open(audioPackPath)) {
+        printf("Error: could not read back %s\n", audioPackPath);
+        return 1;
+    }
+    printf("wrote %s at %u Hz\n", audioPackPath, pack.sampleRate());
+    return 0;
+}
+
+// Streams the .apkg's notes into lessons after the existing ones, importLessonSize notes each.
+// Only one lesson is held at a time, so a deck of any size imports in bounded memory.
+int importApkg() {
+    Uint64 start = SDL_GetPerformanceCounter();
+    ApkgReader reader;
+    if (!reader.open(importPath)) {
+        printf("Error: %s\n", reader.error().c_str());
+        return 1;
+    }
+    // the first notes are held back until the fields are known
+    std::vector<std::vector<std::string>> sample;
+    std::vector<std::string> note;
+    while (sample.size() < importSampleNotes && reader.next(note)) {
+        sample.push_back(note);
+    }
+    int fieldFor[3] = { -1, -1, -1 };
+    if (importFields) {
+        int numbers[3] = { 0, 0, 0 };
+        sscanf(importFields, "%d,%d,%d", &numbers[CARD_ENGLISH], &numbers[CARD_PINYIN], &numbers[CARD_CHINESE]);
+        for (int field = 0; field < 3; field++) {
+            fieldFor[field] = numbers[field] - 1;
+        }
+    } else {
+        guessCardFields(sample, fieldFor);
+    }
+    if (fieldFor[CARD_ENGLISH] < 0 && fieldFor[CARD_PINYIN] < 0 && fieldFor[CARD_CHINESE] < 0) {
+        printf("Error: no note field to import; give them with --fields ENGLISH,PINYIN,CHINESE\n");
+        return 1;
+    }
+    printf("Fields: english %d, pinyin %d, chinese %d\n", fieldFor[CARD_ENGLISH] + 1, fieldFor[CARD_PINYIN] + 1, fieldFor[CARD_CHINESE] + 1);
+    fs::create_directories("lessons");
+
+    int firstLesson = countLessons() + 1;
+    int lessonNumber = firstLesson;
+    int inLesson = 0;
+    size_t imported = 0;
+    size_t skipped = 0;
+    std::ofstream csv;
+    DeckWriter deck;
+    bool ok = true;
+    std::string lessonPath;
+    std::string cells[3];
+    auto addNote = [&](const std::vector<std::string>& fields) {
+        for (int field = 0; field < 3; field++) {
+            int from = fieldFor[field];
+            cells[field] = from >= 0 && from < (int)fields.size() ? fields[from] : std::string();
+        }
+        if (cells[CARD_ENGLISH].empty() && cells[CARD_PINYIN].empty() && cells[CARD_CHINESE].empty()) {
+            skipped++;
+            return;
+        }
+        if (inLesson == 0) {
+            lessonPath = "lessons/lesson" + std::to_string(lessonNumber) + (importPacked ? ".deck" : ".csv");
+            if (importPacked) {
+                ok = deck.open(lessonPath.c_str());
+            } else {
+                csv.open(lessonPath, std::ios::binary);
+                csv << "\xEF\xBB\xBF"; // push_lesson() skips a byte order mark
+            }
+        }
+        if (importPacked) {
+            deck.add(cells[CARD_ENGLISH], cells[CARD_PINYIN], cells[CARD_CHINESE]);
+        } else {
+            csv << csvCell(cells[CARD_ENGLISH].c_str()) << "," << csvCell(cells[CARD_PINYIN].c_str()) << "," << csvCell(cells[CARD_CHINESE].c_str()) << "\n";
+        }
+        imported++;
+        if (++inLesson == importLessonSize) {
+            ok = importPacked ? deck.close() : csv.good();
+            csv.close();
+            inLesson = 0;
+            lessonNumber++;
+        }
+    };
+    for (const std::vector<std::string>& held : sample) {
+        addNote(held);
+    }
+    std::vector<std::vector<std::string>>().swap(sample);
+    while (ok && reader.next(note)) {
+        addNote(note);
+    }
+    if (ok && inLesson > 0) {
+        ok = importPacked ? deck.close() : csv.good();
+        csv.close();
+        lessonNumber++;
+    }
+    if (!ok) {
+        printf("Error: could not write %s\n", lessonPath.c_str());
+        return 1;
+    }
+
+    double seconds = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("Imported %zu notes (%zu empty skipped) as lessons %d-%d in %.2f s: %.0f notes/s, %.1f MB collection, %.1f MB peak memory\n",
+        imported, skipped, firstLesson, lessonNumber - 1, seconds, imported / seconds,
+        reader.collectionBytes() / 1048576.0, usage.ru_maxrss / 1024.0);
+    return 0;
+}
+
+// The front card of the profile's session; NEXT can ask for its text along with it
+void replyFrontCard(ReviewConnection& connection, const ReviewRequest& request, bool withText) {
+    if (profile->active_set.empty()) {
+        connection.reply(request, REVIEW_EMPTY, ANY_CARD);
+        return;
+    }
+    CardId card = profile->active_set.front();
+    if (!withText) {
+        connection.reply(request, REVIEW_OK, card);
+        return;
+    }
+    reviewText.clear();
+    for (CardText field : { CARD_ENGLISH, CARD_PINYIN, CARD_CHINESE }) {
+        reviewText.append(cardStore.text(field, card));
+        reviewText.push_back('\0');
+    }
+    connection.reply(request, REVIEW_OK, card, reviewText.data(), (uint32_t)reviewText.size());
+}
+
+// One request from a --serve client, for the profile the connection opened
+void handleReview(ReviewConnection& connection, const ReviewRequest& request, const char* payload) {
+    if (request.op == REVIEW_OPEN) {
+        std::string name(payload, request.length);
+        Profile* opened = name.empty() ? nullptr : findProfile(name.c_str());
+        if (!opened && !name.empty()) {
+            addProfile(name.c_str());
+            saveProfiles();
+            opened = profile;
+        }
+        connection.user = opened;
+        connection.reply(request, opened ? REVIEW_OK : REVIEW_BAD_REQUEST, ANY_CARD);
+        return;
+    }
+    profile = (Profile*)connection.user;
+    if (!profile) {
+        connection.reply(request, REVIEW_NO_PROFILE, ANY_CARD);
+        return;
+    }
+    switch (request.op) {
+    case REVIEW_START:
+        if (request.arg != ALL_LESSONS && request.arg >= lessonInfo.size()) {
+            connection.reply(request, REVIEW_BAD_REQUEST, ANY_CARD);
+            break;
+        }
+        profile->sessionCards.clear();
+        profile->inactive_set.clear();
+        for (size_t i = 0; i < lessonInfo.size(); i++) {
+            if (request.arg == ALL_LESSONS || request.arg == i) {
+                for (int card = 0; card < lessonInfo[i].cardCount; card++) {
+                    profile->sessionCards.push_back(lessonInfo[i].firstCard + card);
+                }
+            }
+        }
+        beginSession();
+        setSessionWeighted((request.flags & REVIEW_WEIGHTED) != 0);
+        profile->sessionChanged = true;
+        replyFrontCard(connection, request, false);
+        break;
+    case REVIEW_NEXT:
+        replyFrontCard(connection, request, (request.flags & REVIEW_WANT_TEXT) != 0);
+        break;
+    case REVIEW_GRADE:
+        if (profile->active_set.empty()) {
+            connection.reply(request, REVIEW_EMPTY, ANY_CARD);
+        } else if (request.card != ANY_CARD && request.card != profile->active_set.front()) {
+            connection.reply(request, REVIEW_STALE, profile->active_set.front());
+        } else {
+            if (request.arg) {
+                answerCorrect();
+            } else {
+                answerIncorrect();
+            }
+            connection.reply(request, REVIEW_OK, profile->active_set.empty() ? ANY_CARD : profile->active_set.front());
+        }
+        break;
+    case REVIEW_STATS: {
+        CardStats stats = {};
+        addCardStats(profile->schedule, 0, cardStore.size(), currentDay(), stats);
+        connection.reply(request, REVIEW_OK, ANY_CARD, &stats, sizeof(stats));
+        break;
+    }
+    case REVIEW_SYNC: {
+        const char* data = payload;
+        if (!ReviewLog::decodeClocks(data, payload + request.length, syncClocks)) {
+            connection.reply(request, REVIEW_BAD_REQUEST, ANY_CARD);
+            break;
+        }
+        syncPayload.clear();
+        ReviewLog::encodeClocks(profile->reviewLog.clocks(), syncPayload);
+        profile->reviewLog.encodeSince(syncClocks, syncPayload);
+        connection.reply(request, REVIEW_OK, ANY_CARD, syncPayload.data(), (uint32_t)syncPayload.size());
+        break;
+    }
+    case REVIEW_PUSH: {
+        syncTouched.clear();
+        size_t merged = 0;
+        bool valid = profile->reviewLog.merge(payload, request.length, syncTouched, cardStore.size(), merged);
+        // whatever was merged before anything malformed is kept, so it's replayed either way
+        profile->reviewLog.replay(profile->schedule, syncTouched);
+        profile->reviewLog.flush();
+        connection.reply(request, valid ? REVIEW_OK : REVIEW_BAD_REQUEST, (uint32_t)merged);
+        break;
+    }
+    default:
+        connection.reply(request, REVIEW_BAD_REQUEST, ANY_CARD);
+        break;
+    }
+}
+
+// Like the end of a frame: every profile changed by the batch queues its session for saving
+void reviewBatchDone() {
+    for (Profile& changed : profiles) {
+        if (changed.sessionChanged) {
+            profile = &changed;
+            saveSession();
+        }
+    }
+}
+
+void stopServing(int) {
+    reviewServer.stop();
+}
+
+int serveReviews() {
+    if (!reviewServer.listen(serveAddress)) {
+        printf("Error: could not listen on %s\n", serveAddress);
+        return 1;
+    }
+    printf("Serving %u cards on %s\n", cardStore.size(), serveAddress);
+    fflush(stdout);
+    struct sigaction action = {};
+    action.sa_handler = stopServing;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN); // a client gone mid-reply is closed, not fatal
+    reviewServer.run(handleReview, reviewBatchDone);
+    for (Profile& stopping : profiles) {
+        stopping.snapshotWriter.stop();
+    }
+    printf("Handled %llu requests\n", (unsigned long long)reviewServer.requestsHandled());
+    return 0;
+}
+
+void appendSyncRequest(std::vector<char>& out, ReviewOp op, const void* payload, size_t length) {
+    ReviewRequest request = {};
+    request.op = (uint8_t)op;
+    request.length = (uint16_t)length;
+    request.card = ANY_CARD;
+    const char* bytes = (const char*)&request;
+    out.insert(out.end(), bytes, bytes + sizeof(request));
+    out.insert(out.end(), (const char*)payload, (const char*)payload + length);
+}
+
+bool readSyncReply(int fd, ReviewReply& reply, std::vector<char>& payload) {
+    if (!readAll(fd, &reply, sizeof(reply))) {
+        return false;
+    }
+    payload.resize(reply.length);
+    return readAll(fd, payload.data(), payload.size());
+}
+
+// Brings each profile's log and the server's copy level: one round trip swaps clocks and
+// fetches what this install lacks, then what the server lacks is pushed a group per request,
+// all written before any reply is read
+int syncProfiles() {
+    int fd = connectReviewServer(syncAddress);
+    if (fd < 0) {
+        printf("Error: could not connect to %s\n", syncAddress);
+        return 1;
+    }
+    std::vector<char> out;
+    std::vector<char> in;
+    std::vector<char> clocks;
+    std::vector<char> groups;
+    std::vector<LogClock> serverClocks;
+    std::vector<CardId> touched;
+    int result = 0;
+    for (Profile& synced : profiles) {
+        Uint64 start = SDL_GetPerformanceCounter();
+        out.clear();
+        clocks.clear();
+        appendSyncRequest(out, REVIEW_OPEN, synced.name.data(), synced.name.size());
+        ReviewLog::encodeClocks(synced.reviewLog.clocks(), clocks);
+        appendSyncRequest(out, REVIEW_SYNC, clocks.data(), clocks.size());
+        size_t sent = out.size();
+        ReviewReply opened;
+        ReviewReply reply;
+        bool ok = writeAll(fd, out.data(), out.size()) && readSyncReply(fd, opened, in) && readSyncReply(fd, reply, in)
+            && opened.status == REVIEW_OK && reply.status == REVIEW_OK;
+        size_t received = 2 * sizeof(ReviewReply) + in.size();
+        const char* data = in.data();
+        touched.clear();
+        size_t fetched = 0;
+        ok = ok && ReviewLog::decodeClocks(data, in.data() + in.size(), serverClocks)
+            && synced.reviewLog.merge(data, in.data() + in.size() - data, touched, cardStore.size(), fetched);
+        synced.reviewLog.replay(synced.schedule, touched);
+
+        groups.clear();
+        std::vector<size_t> groupEnds = ok ? synced.reviewLog.encodeSince(serverClocks, groups) : std::vector<size_t>();
+        out.clear();
+        for (size_t i = 0, begin = 0; i < groupEnds.size(); begin = groupEnds[i++]) {
+            appendSyncRequest(out, REVIEW_PUSH, groups.data() + begin, groupEnds[i] - begin);
+        }
+        sent += out.size();
+        size_t pushed = 0;
+        ok = ok && writeAll(fd, out.data(), out.size());
+        for (size_t i = 0; ok && i < groupEnds.size(); i++) {
+            ok = readSyncReply(fd, reply, in) && reply.status == REVIEW_OK;
+            received += sizeof(reply) + in.size();
+            pushed += reply.card;
+        }
+        synced.reviewLog.flush();
+        if (!ok) {
+            printf("Error: sync of %s with %s failed\n", synced.name.c_str(), syncAddress);
+            result = 1;
+            break;
+        }
+        double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+        printf("%s: fetched %zu answers, pushed %zu; %zu bytes sent, %zu received in %.2f ms\n",
+            synced.name.c_str(), fetched, pushed, sent, received, ms);
+    }
+    close(fd);
+    for (Profile& stopping : profiles) {
+        stopping.snapshotWriter.stop();
+    }
+    return result;
+}
+
+// Main code
+int main(int argc, char** argv)
+{
+    parseArgs(argc, argv);
+    if (deckCorpusPath) {
+        loadLibrary();
+        return makeDeck();
+    }
+    if (importPath) {
+        return importApkg();
+    }
+    if (audioPackDirectory) {
+        return makeAudioPack();
+    }
+    if (loadTestAddress) {
+        return runReviewLoad(loadTestAddress, loadClients, loadBatch, loadSeconds);
+    }
+    if (syncAddress) {
+        loadLibrary();
+        cardStore.share(cardStorePath);
+        loadProfiles();
+        return syncProfiles();
+    }
+    if (serveAddress) {
+        sessionSnapshots = sessionPathGiven;
+        loadLibrary();
+        cardStore.share(cardStorePath);
+        loadProfiles();
+        return serveReviews();
+    }
+    if (maxFrames < 0) {
+        maxFrames = headless && !replayPath ? 600 : 0;
+    }
+    if (setup() != 0) {
+        return -1;
+    }
+
+    if (replayPath) {
+        if (!replay.load(replayPath)) {
+            printf("Error: could not read replay %s\n", replayPath);
+            return -1;
+        }
+        rngSeed = replay.seed();
+    }
+    if (recordPath && !recorder.start(recordPath, rngSeed)) {
+        printf("Error: could not write recording %s\n", recordPath);
+        return -1;
+    }
+    sessionSnapshots = !replayPath || sessionPathGiven;
+
+    loadLibrary();
+    cardStore.share(cardStorePath);
+    loadProfiles();
+    pinyinAudio.open(audioPackPath);
+    startConfusableCommit();
 
     // Our state
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
     // Main loop
     bool open = true;
+    uint32_t frame = 0;
+    Page previousFramePage = profile->currentPage;
     while (open)
     {
+        if (maxFrames > 0 && frame == (uint32_t)maxFrames) {
+            break;
+        }
+        Uint64 frameStart = SDL_GetPerformanceCounter();
+        currentFrame = frame;
+        bool fontsRebuilt = addMissingGlyphs();
+        allocTracker.beginFrame();
+        Page framePage = profile->currentPage;
+        bool hadInput = false;
+
         SDL_Event event;
-        while (SDL_PollEvent(&event))
         {
-            ImGui_ImplSDL2_ProcessEvent(&event);
-            if (event.type == SDL_QUIT)
-                open = false;
-            if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE && event.window.windowID == SDL_GetWindowID(window))
-                open = false;
+            AllocScope inputScope(ALLOC_INPUT);
+            while (SDL_PollEvent(&event))
+            {
+                // while replaying, live input is ignored apart from closing the window
+                if (!replayPath) {
+                    recorder.record(frame, event);
+                    hadInput |= ImGui_ImplSDL2_ProcessEvent(&event);
+                }
+                if (event.type == SDL_QUIT)
+                    open = false;
+                if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE && event.window.windowID == SDL_GetWindowID(window))
+                    open = false;
+            }
+            if (replayPath) {
+                while (replay.next(frame, &event))
+                {
+                    hadInput |= ImGui_ImplSDL2_ProcessEvent(&event);
+                    if (event.type == SDL_QUIT)
+                        open = false;
+                }
+                if (replay.finished())
+                    open = false;
+            }
         }
 
         // Start the Dear ImGui frame
-        ImGui_ImplOpenGL2_NewFrame();
-        ImGui_ImplSDL2_NewFrame();
+        if (headless) {
+            ImGui_ImplSoft_NewFrame();
+            ImGui_ImplSDL2_NewFrame();
+        } else {
+            ImGui_ImplOpenGL2_NewFrame();
+            ImGui_ImplSDL2_NewFrame();
+        }
+        if (headless || (replayPath && !replay.isRealtime())) {
+            io->DeltaTime = 1.0f / 60.0f; // fixed step so screenshots and replays are reproducible
+        }
         ImGui::NewFrame();
+        textLayouts.invalidateIfStale();
 
         {
+            AllocScope pagesScope(ALLOC_PAGES);
             static float f = 0.0f;
             static int counter = 0;
 
@@ -358,11 +2156,12 @@ int main(int, char**)
                 ImGuiWindowFlags_NoMove |
                 ImGuiWindowFlags_NoResize |
                 ImGuiWindowFlags_NoCollapse |
-                ImGuiWindowFlags_NoNav;
+                ImGuiWindowFlags_NoNav |
+                ImGuiWindowFlags_NoBringToFrontOnFocus;
 
             ImGui::Begin("Hello, world!", nullptr, window_flags);     // Create a window called "Hello, world!" and append into it.
 
-            switch (currentPage) {
+            switch (profile->currentPage) {
             case LESSON_SELECTION:
                 showLessonSelection();
                 break;
@@ -378,21 +2177,84 @@ int main(int, char**)
             case SHOW_RESULTS:
                 showResults();
                 break;
+            case CARD_BROWSER:
+                showCardBrowser();
+                break;
+            case STATISTICS:
+                showStatistics();
+                break;
+            }
+            if (profile->sessionChanged) {
+                saveSession();
             }
 
             ImGui::End();
+
+            if (ImGui::IsKeyPressed(ImGuiKey_F1, false)) {
+                showOverlay = !showOverlay;
+            }
+            if (showOverlay) {
+                showDebugOverlay();
+            }
         }
 
         // Rendering
+        AllocScope renderScope(ALLOC_RENDER);
         ImGui::Render();
-        glViewport(0, 0, io->DisplaySize.x, io->DisplaySize.y);
-        glClearColor(clear_color.x * clear_color.w, clear_color.y * clear_color.w, clear_color.z * clear_color.w, clear_color.w);
-        glClear(GL_COLOR_BUFFER_BIT);
-        ImGui_ImplOpenGL2_RenderDrawData(ImGui::GetDrawData());
-        SDL_GL_SwapWindow(window);
+        if (headless) {
+            ImGui_ImplSoft_Clear(clear_color);
+            ImGui_ImplSoft_RenderDrawData(ImGui::GetDrawData());
+        } else {
+            glViewport(0, 0, io->DisplaySize.x, io->DisplaySize.y);
+            glClearColor(clear_color.x * clear_color.w, clear_color.y * clear_color.w, clear_color.z * clear_color.w, clear_color.w);
+            glClear(GL_COLOR_BUFFER_BIT);
+            ImGui_ImplOpenGL2_RenderDrawData(ImGui::GetDrawData());
+            SDL_GL_SwapWindow(window);
+        }
+
+        Uint64 frameEnd = SDL_GetPerformanceCounter();
+        lastFrameMs = (frameEnd - frameStart) * 1000.0 / SDL_GetPerformanceFrequency();
+        frameStats.addFrame(lastFrameMs);
+        if (answerPressedAt && frame > answerFrame) {
+            lastAnswerLatencyMs = (frameEnd - answerPressedAt) * 1000.0 / SDL_GetPerformanceFrequency();
+            answerLatency.addFrame(lastAnswerLatencyMs);
+            answerPressedAt = 0;
+        }
+
+        // a frame is steady when nothing happened to change what is on screen
+        bool steady = frame >= allocWarmupFrames && !hadInput && !fontsRebuilt && framePage == previousFramePage && profile->currentPage == framePage;
+        allocTracker.endFrame(steady);
+        previousFramePage = framePage;
+        frame++;
+    }
+    recorder.stop(frame);
+
+    if (headless || replayPath) {
+        printf("seed %u, ", rngSeed);
+        frameStats.printSummary();
+        if (answerLatency.frames()) {
+            answerLatency.printSummary("answers");
+        }
+        pinyinAudio.printSummary();
+    }
+    if (histogramPath && !frameStats.writeHistogram(histogramPath)) {
+        printf("Error: could not write %s\n", histogramPath);
+    }
+    if (headless && screenshotPath && !ImGui_ImplSoft_SaveScreenshot(screenshotPath)) {
+        printf("Error: could not write %s\n", screenshotPath);
+    }
+    if (failOnAlloc) {
+        allocTracker.printSummary();
     }
 
+    // closing the window mid-session lands here too; the latest state is written before exit
+    for (Profile& stopping : profiles) {
+        stopping.snapshotWriter.stop();
+    }
     cleanup();
 
+    if (failOnAlloc && allocTracker.steadyFramesWithAllocs() != 0) {
+        return 1;
+    }
     return 0;
 }
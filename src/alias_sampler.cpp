@@ -0,0 +1,80 @@
+#include "alias_sampler.h"
+#include <algorithm>
+#include <math.h>
+
+// The overflow list grows with the square root of the item count: long enough that a
+// rebuild's O(n) is spread over many updates, short enough that scanning it stays cheap
+static size_t overflowLimit(size_t count) {
+    return std::max<size_t>(256, (size_t)(4.0 * sqrt((double)count)));
+}
+
+void AliasSampler::build(const std::vector<double>& newWeights) {
+    weights = newWeights;
+    rebuild();
+}
+
+void AliasSampler::rebuild() {
+    size_t count = weights.size();
+    caps = weights;
+    keep.resize(count);
+    alias.resize(count);
+    overflow.clear();
+    overflowTotal = 0.0;
+    capTotal = 0.0;
+    for (double weight : weights) {
+        capTotal += weight;
+    }
+    keptTotal = capTotal;
+    rebuildCount++;
+    if (count == 0 || capTotal <= 0.0) {
+        return;
+    }
+
+    // Scale so the average column is 1, then pair each short column with a tall one that
+    // tops it up, until every column holds exactly 1
+    smallColumns.clear();
+    largeColumns.clear();
+    double scale = count / capTotal;
+    for (uint32_t i = 0; i < count; i++) {
+        keep[i] = weights[i] * scale;
+        alias[i] = i;
+        (keep[i] < 1.0 ? smallColumns : largeColumns).push_back(i);
+    }
+    while (!smallColumns.empty() && !largeColumns.empty()) {
+        uint32_t small = smallColumns.back();
+        smallColumns.pop_back();
+        uint32_t large = largeColumns.back();
+        alias[small] = large;
+        keep[large] -= 1.0 - keep[small];
+        if (keep[large] < 1.0) {
+            largeColumns.pop_back();
+            smallColumns.push_back(large);
+        }
+    }
+    // whatever is left is 1 up to rounding
+    for (uint32_t i : largeColumns) {
+        keep[i] = 1.0;
+    }
+    for (uint32_t i : smallColumns) {
+        keep[i] = 1.0;
+    }
+}
+
+void AliasSampler::update(uint32_t item, double weight) {
+    double before = overflowWeight(item);
+    keptTotal += std::min(weight, caps[item]) - std::min(weights[item], caps[item]);
+    weights[item] = weight;
+    double after = overflowWeight(item);
+    overflowTotal += after - before;
+    if (before == 0.0 && after > 0.0) {
+        overflow.push_back(item);
+    } else if (before > 0.0 && after == 0.0) {
+        overflow.erase(std::find(overflow.begin(), overflow.end(), item));
+        if (overflow.empty()) {
+            overflowTotal = 0.0; // drop any rounding left over
+        }
+    }
+    if (overflow.size() > overflowLimit(weights.size()) || keptTotal < capTotal * 0.5) {
+        rebuild();
+    }
+}
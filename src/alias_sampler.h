@@ -0,0 +1,74 @@
+#pragma once
+
+#include <random>
+#include <stdint.h>
+#include <vector>
+
+// Draws items with probability proportional to their weights in O(1), by Vose's alias
+// method: one column per item, each holding part of its own item's weight and the rest of
+// one other item's, so a draw is one uniform column and one biased coin.
+//
+// A table only describes the weights it was built from, so changes are layered on top
+// instead of rebuilding after each one. The table keeps each item's weight from the last
+// build as a cap. A draw from the table is accepted with chance weight / cap, which
+// covers any weight that went down. Weight above the cap goes in a short overflow list,
+// drawn from directly. The table is rebuilt, in O(n), once the overflow list is full or
+// fewer than half of the table's draws would be accepted, so updates are O(1) amortized.
+class AliasSampler {
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    void build(const std::vector<double>& weights);
+    // Zero takes the item out of the draw
+    void update(uint32_t item, double weight);
+    double weight(uint32_t item) const { return weights[item]; }
+    double total() const { return keptTotal + overflowTotal; }
+    uint32_t rebuilds() const { return rebuildCount; }
+
+    // NONE when every weight is zero
+    template<typename Rng>
+    uint32_t draw(Rng& rng) const;
+
+private:
+    void rebuild();
+    double overflowWeight(uint32_t item) const { return weights[item] > caps[item] ? weights[item] - caps[item] : 0.0; }
+
+    std::vector<double> weights;
+    std::vector<double> caps;           // weights at the last build
+    std::vector<double> keep;           // chance a column's draw is its own item rather than its alias
+    std::vector<uint32_t> alias;
+    std::vector<uint32_t> overflow;     // items whose weight rose past their cap
+    std::vector<uint32_t> smallColumns; // rebuild scratch
+    std::vector<uint32_t> largeColumns;
+    double capTotal = 0.0;
+    double keptTotal = 0.0;             // sum of min(weight, cap): what table draws accept
+    double overflowTotal = 0.0;         // sum of the weight above the caps
+    uint32_t rebuildCount = 0;
+};
+
+template<typename Rng>
+uint32_t AliasSampler::draw(Rng& rng) const {
+    if (total() <= 0.0) {
+        return NONE;
+    }
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    if (!overflow.empty() && unit(rng) * total() < overflowTotal) {
+        double target = unit(rng) * overflowTotal;
+        for (uint32_t item : overflow) {
+            target -= overflowWeight(item);
+            if (target < 0.0) {
+                return item;
+            }
+        }
+        return overflow.back(); // rounding left a sliver
+    }
+    std::uniform_int_distribution<uint32_t> column(0, (uint32_t)weights.size() - 1);
+    while (true) {
+        uint32_t c = column(rng);
+        uint32_t item = unit(rng) < keep[c] ? c : alias[c];
+        // a weight that fell since the build is accepted that much less often
+        if (weights[item] >= caps[item] || unit(rng) * caps[item] < weights[item]) {
+            return item;
+        }
+    }
+}
@@ -0,0 +1,161 @@
+#include "alloc_profiler.h"
+#include "imgui.h"
+#include <atomic>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+
+static std::atomic<uint64_t> allocationCount[ALLOC_SUBSYSTEM_COUNT];
+static std::atomic<uint64_t> allocationBytes[ALLOC_SUBSYSTEM_COUNT];
+static thread_local AllocSubsystem currentSubsystem = ALLOC_OTHER;
+
+static inline void countAllocation(AllocSubsystem subsystem, size_t size) {
+    allocationCount[subsystem].fetch_add(1, std::memory_order_relaxed);
+    allocationBytes[subsystem].fetch_add(size, std::memory_order_relaxed);
+}
+
+uint64_t AllocCounts::totalAllocations() const {
+    uint64_t total = 0;
+    for (int i = 0; i < ALLOC_SUBSYSTEM_COUNT; i++) {
+        total += allocations[i];
+    }
+    return total;
+}
+
+uint64_t AllocCounts::totalBytes() const {
+    uint64_t total = 0;
+    for (int i = 0; i < ALLOC_SUBSYSTEM_COUNT; i++) {
+        total += bytes[i];
+    }
+    return total;
+}
+
+const char* allocSubsystemName(AllocSubsystem subsystem) {
+    switch (subsystem) {
+    case ALLOC_OTHER: return "other";
+    case ALLOC_IMGUI: return "imgui";
+    case ALLOC_INPUT: return "input";
+    case ALLOC_PAGES: return "pages";
+    case ALLOC_RENDER: return "render";
+    case ALLOC_LOADING: return "loading";
+    case ALLOC_PREFETCH: return "prefetch";
+    case ALLOC_SNAPSHOT: return "snapshot";
+    case ALLOC_AUDIO: return "audio";
+    case ALLOC_CONFUSABLES: return "confusables";
+    default: return "?";
+    }
+}
+
+bool allocSubsystemIsBackground(AllocSubsystem subsystem) {
+    return subsystem == ALLOC_PREFETCH || subsystem == ALLOC_SNAPSHOT || subsystem == ALLOC_AUDIO
+        || subsystem == ALLOC_CONFUSABLES;
+}
+
+AllocCounts allocCountsNow() {
+    AllocCounts counts;
+    for (int i = 0; i < ALLOC_SUBSYSTEM_COUNT; i++) {
+        counts.allocations[i] = allocationCount[i].load(std::memory_order_relaxed);
+        counts.bytes[i] = allocationBytes[i].load(std::memory_order_relaxed);
+    }
+    return counts;
+}
+
+AllocSubsystem currentAllocSubsystem() {
+    return currentSubsystem;
+}
+
+AllocScope::AllocScope(AllocSubsystem subsystem) : previous(currentSubsystem) {
+    currentSubsystem = subsystem;
+}
+
+AllocScope::~AllocScope() {
+    currentSubsystem = previous;
+}
+
+static void* imguiAlloc(size_t size, void*) {
+    countAllocation(ALLOC_IMGUI, size);
+    return malloc(size);
+}
+
+static void imguiFree(void* ptr, void*) {
+    free(ptr);
+}
+
+void installImGuiAllocHooks() {
+    ImGui::SetAllocatorFunctions(imguiAlloc, imguiFree);
+}
+
+void FrameAllocTracker::beginFrame() {
+    start = allocCountsNow();
+}
+
+void FrameAllocTracker::endFrame(bool steady) {
+    AllocCounts now = allocCountsNow();
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    for (int i = 0; i < ALLOC_SUBSYSTEM_COUNT; i++) {
+        last.allocations[i] = now.allocations[i] - start.allocations[i];
+        last.bytes[i] = now.bytes[i] - start.bytes[i];
+        if (!allocSubsystemIsBackground((AllocSubsystem)i)) {
+            allocations += last.allocations[i];
+            bytes += last.bytes[i];
+        }
+    }
+    if (steady && allocations != 0) {
+        badFrames++;
+        badAllocations += allocations;
+        badBytes += bytes;
+    }
+}
+
+void FrameAllocTracker::printSummary() const {
+    AllocCounts total = allocCountsNow();
+    printf("allocations since startup:");
+    for (int i = 0; i < ALLOC_SUBSYSTEM_COUNT; i++) {
+        printf(" %s %llu (%llu bytes)", allocSubsystemName((AllocSubsystem)i),
+            (unsigned long long)total.allocations[i], (unsigned long long)total.bytes[i]);
+    }
+    printf("\nsteady-state frames that allocated: %llu (%llu allocations, %llu bytes)\n",
+        (unsigned long long)badFrames, (unsigned long long)badAllocations, (unsigned long long)badBytes);
+}
+
+// Global operator new/delete replacements. Everything funnels into malloc/free
+// so the counters see every allocation the C++ runtime makes for us.
+
+static void* countedNew(size_t size) {
+    countAllocation(currentSubsystem, size);
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+static void* countedAlignedNew(size_t size, std::align_val_t align) {
+    countAllocation(currentSubsystem, size);
+    size_t alignment = (size_t)align;
+    void* ptr = aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new(size_t size) { return countedNew(size); }
+void* operator new[](size_t size) { return countedNew(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    countAllocation(currentSubsystem, size);
+    return malloc(size ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+void* operator new(size_t size, std::align_val_t align) { return countedAlignedNew(size, align); }
+void* operator new[](size_t size, std::align_val_t align) { return countedAlignedNew(size, align); }
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { free(ptr); }
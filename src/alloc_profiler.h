@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Counts heap allocations made through global operator new and through
+// ImGui's allocator, attributed to whichever subsystem is active on the
+// allocating thread
+
+typedef enum AllocSubsystem {
+    ALLOC_OTHER,
+    ALLOC_IMGUI,    // everything through ImGui::MemAlloc, whatever the scope
+    ALLOC_INPUT,
+    ALLOC_PAGES,
+    ALLOC_RENDER,
+    ALLOC_LOADING,
+    ALLOC_PREFETCH, // worker thread, does not count against steady-state frames
+    ALLOC_SNAPSHOT, // worker thread, likewise
+    ALLOC_AUDIO,    // worker thread, likewise
+    ALLOC_CONFUSABLES, // worker thread, likewise
+    ALLOC_SUBSYSTEM_COUNT
+} AllocSubsystem;
+
+typedef struct AllocCounts {
+    uint64_t allocations[ALLOC_SUBSYSTEM_COUNT];
+    uint64_t bytes[ALLOC_SUBSYSTEM_COUNT];
+
+    uint64_t totalAllocations() const;
+    uint64_t totalBytes() const;
+} AllocCounts;
+
+const char* allocSubsystemName(AllocSubsystem subsystem);
+bool allocSubsystemIsBackground(AllocSubsystem subsystem);
+
+// Must be called before ImGui::CreateContext()
+void installImGuiAllocHooks();
+
+// Cumulative counts since startup
+AllocCounts allocCountsNow();
+
+// The subsystem this thread's allocations are attributed to, for handing on to helper threads
+AllocSubsystem currentAllocSubsystem();
+
+// Attributes allocations on this thread to a subsystem until destroyed
+class AllocScope {
+public:
+    explicit AllocScope(AllocSubsystem subsystem);
+    ~AllocScope();
+    AllocScope(const AllocScope&) = delete;
+    AllocScope& operator=(const AllocScope&) = delete;
+
+private:
+    AllocSubsystem previous;
+};
+
+// Per-frame bookkeeping on top of the cumulative counters
+class FrameAllocTracker {
+public:
+    void beginFrame();
+    // 'steady' marks frames whose UI thread should not allocate (no input, no page change)
+    void endFrame(bool steady);
+
+    const AllocCounts& lastFrame() const { return last; }
+    uint64_t steadyFramesWithAllocs() const { return badFrames; }
+    uint64_t steadyAllocations() const { return badAllocations; }
+    void printSummary() const;
+
+private:
+    AllocCounts start = {};
+    AllocCounts last = {};
+    uint64_t badFrames = 0;
+    uint64_t badAllocations = 0;
+    uint64_t badBytes = 0;
+};
@@ -0,0 +1,33 @@
+#include "answer_history.h"
+
+AnswerHistory::AnswerHistory(uint32_t capacity) : records(capacity) {}
+
+void AnswerHistory::clear() {
+    next = 0;
+    undoCount = 0;
+    redoCount = 0;
+}
+
+void AnswerHistory::push(const AnswerRecord& record) {
+    records[next] = record;
+    next = (next + 1) % records.size();
+    if (undoCount < records.size()) {
+        undoCount++;
+    }
+    redoCount = 0;
+}
+
+const AnswerRecord& AnswerHistory::undo() {
+    next = (next + (uint32_t)records.size() - 1) % records.size();
+    undoCount--;
+    redoCount++;
+    return records[next];
+}
+
+const AnswerRecord& AnswerHistory::redo() {
+    const AnswerRecord& record = records[next];
+    next = (next + 1) % records.size();
+    undoCount++;
+    redoCount--;
+    return record;
+}
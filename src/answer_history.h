@@ -0,0 +1,51 @@
+#pragma once
+
+#include "card_schedule.h"
+#include <stdint.h>
+#include <vector>
+
+typedef enum AnswerKind {
+    ANSWER_CORRECT,     // the front card left the session
+    ANSWER_INCORRECT    // the front card went back in at 'position'
+} AnswerKind;
+
+// AnswerRecord::drawnFrom when the answer didn't draw the next card
+static const uint32_t NO_DRAW = UINT32_MAX;
+
+// Everything needed to replay one answer, or to take it back exactly: where the card went
+// and the card's schedule columns from before it was graded
+typedef struct AnswerRecord {
+    CardId card;
+    uint32_t position;
+    uint32_t drawnFrom;     // weighted practice: where the card brought to the front next was
+    uint32_t day;           // the review day the answer was scheduled from
+    uint32_t due;
+    uint16_t interval;
+    uint16_t ease;
+    uint16_t lapses;
+    uint8_t status;
+    uint8_t kind;           // AnswerKind
+} AnswerRecord;
+
+// The last answers of a session in a fixed ring: once full, each new answer drops the
+// oldest. Undo walks back and redo forward; a new answer after undoing drops what could
+// have been redone. Every operation is O(1) and nothing is allocated after construction.
+class AnswerHistory {
+public:
+    explicit AnswerHistory(uint32_t capacity);
+
+    void clear();
+    void push(const AnswerRecord& record);
+    bool canUndo() const { return undoCount != 0; }
+    bool canRedo() const { return redoCount != 0; }
+    // The answer to take back, which becomes the next to redo
+    const AnswerRecord& undo();
+    // The answer to apply again, which becomes the next to undo
+    const AnswerRecord& redo();
+
+private:
+    std::vector<AnswerRecord> records;
+    uint32_t next = 0;          // slot the next answer goes in
+    uint32_t undoCount = 0;     // answers before 'next'
+    uint32_t redoCount = 0;     // undone answers from 'next' on
+};
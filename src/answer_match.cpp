@@ -0,0 +1,163 @@
+#include "answer_match.h"
+#include "pinyin_index.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+int editDistance(const char* a, size_t aLength, const char* b, size_t bLength, int bound) {
+    int lengthDifference = (int)aLength - (int)bLength;
+    if (abs(lengthDifference) > bound) {
+        return bound + 1;
+    }
+    if (aLength == 0) {
+        return (int)bLength;
+    }
+
+    if (aLength <= 64) {
+        // Column j holds D[i][j] - D[i-1][j] for every i as positive/negative bit vectors;
+        // 'score' follows the bottom row, D[m][j]
+        uint64_t peq[256] = {};
+        for (size_t i = 0; i < aLength; i++) {
+            peq[(unsigned char)a[i]] |= 1ull << i;
+        }
+        uint64_t pv = aLength == 64 ? ~0ull : (1ull << aLength) - 1;
+        uint64_t mv = 0;
+        uint64_t last = 1ull << (aLength - 1);
+        int score = (int)aLength;
+        for (size_t j = 0; j < bLength; j++) {
+            uint64_t eq = peq[(unsigned char)b[j]];
+            uint64_t xv = eq | mv;
+            uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+            uint64_t ph = mv | ~(xh | pv);
+            uint64_t mh = pv & xh;
+            if (ph & last) {
+                score++;
+            } else if (mh & last) {
+                score--;
+            }
+            ph = (ph << 1) | 1; // the top row D[0][j] = j grows by one per column
+            mh <<= 1;
+            pv = mh | ~(xv | ph);
+            mv = ph & xv;
+            // the remaining characters can lower the score by at most one each
+            if (score - (int)(bLength - j - 1) > bound) {
+                return bound + 1;
+            }
+        }
+        return score;
+    }
+
+    // Longer than a word: one DP row at a time, stopping once every cell is past the bound
+    std::vector<int> row(aLength + 1);
+    for (size_t i = 0; i <= aLength; i++) {
+        row[i] = (int)i;
+    }
+    for (size_t j = 0; j < bLength; j++) {
+        int diagonal = row[0];
+        row[0] = (int)j + 1;
+        int best = row[0];
+        for (size_t i = 1; i <= aLength; i++) {
+            int above = row[i];
+            int cost = a[i - 1] == b[j] ? 0 : 1;
+            int value = diagonal + cost;
+            if (above + 1 < value) value = above + 1;
+            if (row[i - 1] + 1 < value) value = row[i - 1] + 1;
+            row[i] = value;
+            diagonal = above;
+            if (value < best) best = value;
+        }
+        if (best > bound) {
+            return bound + 1;
+        }
+    }
+    return row[aLength];
+}
+
+// Lowercase words separated by single spaces, without parenthesized notes unless
+// the note is all there is ("(question particle)")
+static void normalizeEnglish(const char* begin, const char* end, std::string& out) {
+    for (int keepNotes = 0; keepNotes < 2 && out.empty(); keepNotes++) {
+        int depth = 0;
+        bool space = false;
+        for (const char* p = begin; p < end; p++) {
+            unsigned char c = (unsigned char)*p;
+            if (c == '(') {
+                depth++;
+            } else if (c == ')') {
+                depth = depth > 0 ? depth - 1 : 0;
+            }
+            if (depth > 0 && !keepNotes) {
+                continue;
+            }
+            if (c >= 'A' && c <= 'Z') {
+                c += 'a' - 'A';
+            }
+            if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80) {
+                if (space && !out.empty()) {
+                    out += ' ';
+                }
+                out += (char)c;
+                space = false;
+            } else {
+                space = true;
+            }
+        }
+    }
+}
+
+static void normalizeAnswer(const char* begin, const char* end, bool pinyin, std::string& out) {
+    out.clear();
+    if (pinyin) {
+        // tones and spacing don't count, so only the letters are compared
+        static NormalizedPinyin normalized;
+        normalizePinyin(std::string(begin, end), normalized);
+        out = normalized.letters;
+    } else {
+        normalizeEnglish(begin, end, out);
+    }
+}
+
+static int allowedEdits(size_t length) {
+    // exact up to 4 letters, then one more typo per 4 letters, at most 3
+    int allowed = ((int)length - 1) / 4;
+    return allowed < 0 ? 0 : allowed > 3 ? 3 : allowed;
+}
+
+AnswerGrade gradeAnswer(std::string_view typed, std::string_view expected, bool pinyin) {
+    AnswerGrade grade = { false, 0, 0 };
+    std::string answer;
+    normalizeAnswer(typed.data(), typed.data() + typed.size(), pinyin, answer);
+    if (answer.empty()) {
+        grade.distance = (int)expected.size();
+        return grade;
+    }
+
+    std::string synonym;
+    bool first = true;
+    const char* p = expected.data();
+    const char* end = p + expected.size();
+    while (p <= end) {
+        const char* split = p;
+        while (split < end && *split != ';') {
+            split++;
+        }
+        normalizeAnswer(p, split, pinyin, synonym);
+        p = split + 1;
+        if (synonym.empty()) {
+            continue;
+        }
+        int allowed = allowedEdits(synonym.size());
+        int distance = editDistance(answer.c_str(), answer.size(), synonym.c_str(), synonym.size(), allowed);
+        // keep the closest synonym, and the first accepted one
+        if (first || (distance <= allowed && !grade.correct) || (!grade.correct && distance < grade.distance)) {
+            grade.correct = distance <= allowed;
+            grade.distance = distance;
+            grade.allowed = allowed;
+            first = false;
+        }
+        if (grade.correct && grade.distance == 0) {
+            break;
+        }
+    }
+    return grade;
+}
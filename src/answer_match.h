@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <string_view>
+
+// Grades a typed answer against a card field. The field may list synonyms split on
+// ';' ("year; years old"), any of which is accepted, and parenthesized notes such as
+// "(name)" are optional. Case and punctuation are ignored; for pinyin so are tones and
+// spacing ("jintian" matches "jīntiān"). A few typos are allowed, more for longer answers.
+typedef struct AnswerGrade {
+    bool correct;
+    int distance;       // edits to the closest synonym
+    int allowed;        // edits that synonym allowed
+} AnswerGrade;
+
+AnswerGrade gradeAnswer(std::string_view typed, std::string_view expected, bool pinyin);
+
+// Levenshtein distance, or bound + 1 as soon as it is known to exceed 'bound'.
+// Bit-parallel (Myers/Hyyrö) when 'a' fits in a machine word, one column of the
+// dynamic-programming matrix per character of 'b'.
+int editDistance(const char* a, size_t aLength, const char* b, size_t bLength, int bound);
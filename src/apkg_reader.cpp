@@ -0,0 +1,380 @@
+#include "apkg_reader.h"
+#include "card_store.h"
+#include "utf8.h"
+#include <algorithm>
+#include <filesystem>
+#include <sqlite3.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+static const uint32_t ZIP_END_SIGNATURE = 0x06054b50;
+static const uint32_t ZIP_CENTRAL_SIGNATURE = 0x02014b50;
+static const uint32_t ZIP_LOCAL_SIGNATURE = 0x04034b50;
+static const size_t ZIP_END_SIZE = 22;
+static const size_t ZIP_CENTRAL_SIZE = 46;
+static const size_t ZIP_LOCAL_SIZE = 30;
+static const uint32_t ZIP_STORED = 0;
+static const uint32_t ZIP_DEFLATED = 8;
+
+// Inflated a block of this size at a time
+static const size_t INFLATE_CHUNK = 64 * 1024;
+// SQLite's page cache while the notes are read, in KB; the rows are read once, in order
+static const int PAGE_CACHE_KB = 4096;
+
+static uint16_t le16(const unsigned char* p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t le32(const unsigned char* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+ApkgReader::~ApkgReader() {
+    if (notes) {
+        sqlite3_finalize(notes);
+    }
+    if (database) {
+        sqlite3_close(database);
+    }
+    if (!collectionPath.empty()) {
+        remove(collectionPath.c_str());
+    }
+}
+
+bool ApkgReader::fail(const std::string& why) {
+    message = why;
+    return false;
+}
+
+bool ApkgReader::open(const char* path) {
+    FILE* zip = fopen(path, "rb");
+    if (!zip) {
+        return fail(std::string("could not read ") + path);
+    }
+    // The central directory's end record is in the last 64 KB, behind at most a comment
+    fseeko(zip, 0, SEEK_END);
+    off_t size = ftello(zip);
+    size_t tailSize = (size_t)std::min<off_t>(size, 0xFFFF + ZIP_END_SIZE);
+    std::vector<unsigned char> tail(tailSize);
+    fseeko(zip, size - (off_t)tailSize, SEEK_SET);
+    const unsigned char* end = nullptr;
+    if (tailSize >= ZIP_END_SIZE && fread(tail.data(), 1, tailSize, zip) == tailSize) {
+        for (size_t i = tailSize - ZIP_END_SIZE + 1; i-- > 0;) {
+            if (le32(&tail[i]) == ZIP_END_SIGNATURE) {
+                end = &tail[i];
+                break;
+            }
+        }
+    }
+    if (!end) {
+        fclose(zip);
+        return fail(std::string(path) + " is not a zip file");
+    }
+    uint32_t directorySize = le32(end + 12);
+    uint32_t directoryOffset = le32(end + 16);
+    if (directoryOffset == UINT32_MAX) {
+        fclose(zip);
+        return fail("zip64 archives aren't supported");
+    }
+
+    std::vector<unsigned char> directory(directorySize);
+    fseeko(zip, directoryOffset, SEEK_SET);
+    if (fread(directory.data(), 1, directorySize, zip) != directorySize) {
+        fclose(zip);
+        return fail(std::string(path) + " is truncated");
+    }
+    // Newer Anki writes collection.anki21, and with it sometimes a stub collection.anki2 that
+    // only says to upgrade; collection.anki21b is zstd-compressed, which isn't read here
+    const unsigned char* found[2] = {};
+    bool compressedOnly = false;
+    for (size_t at = 0; at + ZIP_CENTRAL_SIZE <= directory.size();) {
+        const unsigned char* entry = &directory[at];
+        if (le32(entry) != ZIP_CENTRAL_SIGNATURE) {
+            break;
+        }
+        size_t entrySize = ZIP_CENTRAL_SIZE + le16(entry + 28) + le16(entry + 30) + le16(entry + 32);
+        if (at + entrySize > directory.size()) {
+            fclose(zip);
+            return fail(std::string(path) + " is truncated");
+        }
+        std::string_view name((const char*)entry + ZIP_CENTRAL_SIZE, le16(entry + 28));
+        if (name == "collection.anki21") {
+            found[0] = entry;
+        } else if (name == "collection.anki2") {
+            found[1] = entry;
+        } else if (name == "collection.anki21b") {
+            compressedOnly = true;
+        }
+        at += entrySize;
+    }
+    const unsigned char* collection = found[0] ? found[0] : compressedOnly ? nullptr : found[1];
+    if (!collection) {
+        fclose(zip);
+        return fail(compressedOnly ? "this deck was exported for the newest Anki only; export it again with \"Support older Anki versions\" ticked"
+                                   : std::string(path) + " has no Anki collection in it");
+    }
+    bool ok = extract(zip, le32(collection + 42), le16(collection + 10), le32(collection + 20), le32(collection + 16));
+    fclose(zip);
+    if (!ok) {
+        return false;
+    }
+
+    if (sqlite3_open_v2(collectionPath.c_str(), &database, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        return fail(std::string("could not open the collection: ") + sqlite3_errmsg(database));
+    }
+    std::string cache = "PRAGMA cache_size = -" + std::to_string(PAGE_CACHE_KB);
+    sqlite3_exec(database, cache.c_str(), nullptr, nullptr, nullptr);
+    // notes.id is the rowid, so this walks the table in order without sorting
+    if (sqlite3_prepare_v2(database, "SELECT flds FROM notes ORDER BY id", -1, &notes, nullptr) != SQLITE_OK) {
+        return fail(std::string("could not read the notes: ") + sqlite3_errmsg(database));
+    }
+    return true;
+}
+
+// Inflates the collection into a temporary file, checking it against the zip's CRC
+bool ApkgReader::extract(FILE* zip, uint64_t offset, uint32_t method, uint64_t packedSize, uint32_t crc) {
+    unsigned char local[ZIP_LOCAL_SIZE];
+    fseeko(zip, (off_t)offset, SEEK_SET);
+    if (fread(local, 1, sizeof(local), zip) != sizeof(local) || le32(local) != ZIP_LOCAL_SIGNATURE) {
+        return fail("the zip's directory doesn't match its contents");
+    }
+    fseeko(zip, (off_t)(offset + ZIP_LOCAL_SIZE + le16(local + 26) + le16(local + 28)), SEEK_SET);
+    if (method != ZIP_STORED && method != ZIP_DEFLATED) {
+        return fail("the collection is compressed with zip method " + std::to_string(method) + ", which isn't supported");
+    }
+
+    // mkstemp makes the file itself, under a name nobody can have planted a link at beforehand
+    std::string temporary = (std::filesystem::temp_directory_path() / "apkg-XXXXXX").string();
+    int fd = mkstemp(temporary.data());
+    FILE* out = fd >= 0 ? fdopen(fd, "wb") : nullptr;
+    if (!out) {
+        if (fd >= 0) {
+            close(fd);
+            remove(temporary.c_str());
+        }
+        return fail("could not write a temporary file in " + std::filesystem::temp_directory_path().string());
+    }
+    collectionPath = temporary;
+    z_stream stream = {};
+    inflateInit2(&stream, -MAX_WBITS); // zip entries are raw deflate, without a zlib header
+    std::vector<unsigned char> in(INFLATE_CHUNK);
+    std::vector<unsigned char> inflated(INFLATE_CHUNK);
+    uLong check = crc32(0, nullptr, 0);
+    bool ok = true;
+    bool finished = false;
+    while (ok && !finished && packedSize > 0) {
+        size_t want = (size_t)std::min<uint64_t>(packedSize, in.size());
+        ok = fread(in.data(), 1, want, zip) == want;
+        packedSize -= want;
+        if (method == ZIP_STORED) {
+            check = crc32(check, in.data(), (uInt)want);
+            ok = ok && fwrite(in.data(), 1, want, out) == want;
+            extracted += want;
+            continue;
+        }
+        stream.next_in = in.data();
+        stream.avail_in = (uInt)want;
+        // until this block is used up and nothing is left pending from it
+        stream.avail_out = 0;
+        while (ok && !finished && (stream.avail_in > 0 || stream.avail_out == 0)) {
+            stream.next_out = inflated.data();
+            stream.avail_out = (uInt)inflated.size();
+            int result = inflate(&stream, Z_NO_FLUSH);
+            size_t got = inflated.size() - stream.avail_out;
+            if (result == Z_BUF_ERROR && got == 0) {
+                break; // wants the next block
+            }
+            check = crc32(check, inflated.data(), (uInt)got);
+            ok = (result == Z_OK || result == Z_STREAM_END) && fwrite(inflated.data(), 1, got, out) == got;
+            extracted += got;
+            finished = result == Z_STREAM_END;
+        }
+    }
+    inflateEnd(&stream);
+    ok = fclose(out) == 0 && ok;
+    if (!ok || (method == ZIP_DEFLATED && !finished) || check != crc) {
+        return fail("the collection in the zip is damaged");
+    }
+    return true;
+}
+
+// Appends 'codepoint' as UTF-8
+static void appendUtf8(std::string& out, uint32_t codepoint) {
+    if (codepoint < 0x80) {
+        out += (char)codepoint;
+    } else if (codepoint < 0x800) {
+        out += (char)(0xC0 | codepoint >> 6);
+        out += (char)(0x80 | (codepoint & 0x3F));
+    } else if (codepoint < 0x10000) {
+        out += (char)(0xE0 | codepoint >> 12);
+        out += (char)(0x80 | (codepoint >> 6 & 0x3F));
+        out += (char)(0x80 | (codepoint & 0x3F));
+    } else {
+        out += (char)(0xF0 | codepoint >> 18);
+        out += (char)(0x80 | (codepoint >> 12 & 0x3F));
+        out += (char)(0x80 | (codepoint >> 6 & 0x3F));
+        out += (char)(0x80 | (codepoint & 0x3F));
+    }
+}
+
+// One space for any run of spaces and markup that separates words, none at either end
+static void appendSpace(std::string& out) {
+    if (!out.empty() && out.back() != ' ') {
+        out += ' ';
+    }
+}
+
+// Anki fields are HTML; cards are plain text
+static void plainText(std::string_view html, std::string& out) {
+    static const struct Entity {
+        std::string_view name;
+        char text;
+    } entities[] = { { "&nbsp;", ' ' }, { "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' }, { "&quot;", '"' }, { "&apos;", '\'' } };
+    out.clear();
+    for (size_t i = 0; i < html.size();) {
+        char c = html[i];
+        if (c == '<') {
+            size_t close = html.find('>', i);
+            if (close == std::string_view::npos) {
+                break;
+            }
+            std::string_view tag = html.substr(i + 1, close - i - 1);
+            if (tag.rfind("br", 0) == 0 || tag.rfind("div", 0) == 0 || tag.rfind("/div", 0) == 0 || tag == "p" || tag == "/p") {
+                appendSpace(out);
+            }
+            i = close + 1;
+        } else if (c == '[' && html.substr(i, 7) == "[sound:") {
+            size_t close = html.find(']', i);
+            i = close == std::string_view::npos ? html.size() : close + 1;
+        } else if (c == '&') {
+            size_t semicolon = html.find(';', i);
+            std::string_view entity = html.substr(i, semicolon == std::string_view::npos ? 0 : semicolon - i + 1);
+            bool decoded = false;
+            if (entity.size() > 3 && entity[1] == '#') {
+                bool hex = entity[2] == 'x' || entity[2] == 'X';
+                std::string digits(entity.substr(hex ? 3 : 2, entity.size() - (hex ? 4 : 3)));
+                char* digitsEnd;
+                unsigned long codepoint = strtoul(digits.c_str(), &digitsEnd, hex ? 16 : 10);
+                if (!digits.empty() && *digitsEnd == '\0' && codepoint > 0 && codepoint < 0x110000) {
+                    if (codepoint == 0xA0) {
+                        appendSpace(out);
+                    } else {
+                        appendUtf8(out, (uint32_t)codepoint);
+                    }
+                    decoded = true;
+                }
+            }
+            for (const Entity& known : entities) {
+                if (!decoded && entity == known.name) {
+                    if (known.text == ' ') {
+                        appendSpace(out);
+                    } else {
+                        out += known.text;
+                    }
+                    decoded = true;
+                }
+            }
+            if (decoded) {
+                i += entity.size();
+            } else {
+                out += c;
+                i++;
+            }
+        } else if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+            appendSpace(out);
+            i++;
+        } else {
+            out += c;
+            i++;
+        }
+    }
+    if (!out.empty() && out.back() == ' ') {
+        out.pop_back();
+    }
+}
+
+bool ApkgReader::next(std::vector<std::string>& fields) {
+    if (!notes) {
+        return false;
+    }
+    if (sqlite3_step(notes) != SQLITE_ROW) {
+        // stepping again would start over from the first note
+        sqlite3_finalize(notes);
+        notes = nullptr;
+        return false;
+    }
+    const char* text = (const char*)sqlite3_column_text(notes, 0);
+    std::string_view row(text ? text : "", (size_t)sqlite3_column_bytes(notes, 0));
+    size_t count = 0;
+    // fields are separated by the unit separator; the strings are reused from note to note
+    for (size_t start = 0;; count++) {
+        size_t separator = row.find('\x1f', start);
+        if (count == fields.size()) {
+            fields.emplace_back();
+        }
+        plainText(row.substr(start, separator == std::string_view::npos ? std::string_view::npos : separator - start), fields[count]);
+        if (separator == std::string_view::npos) {
+            count++;
+            break;
+        }
+        start = separator + 1;
+    }
+    fields.resize(count);
+    return true;
+}
+
+static bool isToneMarked(uint32_t c) {
+    static const uint32_t marked[] = {
+        0x101, 0xE1, 0x1CE, 0xE0, 0x113, 0xE9, 0x11B, 0xE8, 0x12B, 0xED, 0x1D0, 0xEC,
+        0x14D, 0xF3, 0x1D2, 0xF2, 0x16B, 0xFA, 0x1D4, 0xF9, 0x1D6, 0x1D8, 0x1DA, 0x1DC,
+    };
+    return std::find(std::begin(marked), std::end(marked), c) != std::end(marked);
+}
+
+void guessCardFields(const std::vector<std::vector<std::string>>& sample, int fieldFor[3]) {
+    // per field, how many notes have hanzi, tone marks (or tone numbers, as in "ni3") and latin letters
+    std::vector<int> hanzi, tones, latin;
+    for (const std::vector<std::string>& note : sample) {
+        if (note.size() > hanzi.size()) {
+            hanzi.resize(note.size());
+            tones.resize(note.size());
+            latin.resize(note.size());
+        }
+        for (size_t field = 0; field < note.size(); field++) {
+            bool hasHanzi = false, hasTones = false, hasLatin = false;
+            const char* text = note[field].data();
+            const char* end = text + note[field].size();
+            uint32_t previous = 0;
+            while (text < end) {
+                uint32_t c;
+                text += decodeUtf8(text, end, &c);
+                hasHanzi = hasHanzi || isHanziCodepoint(c);
+                hasTones = hasTones || isToneMarked(c) || (c >= '1' && c <= '5' && ((previous >= 'a' && previous <= 'z') || previous == ':'));
+                hasLatin = hasLatin || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+                previous = c;
+            }
+            hanzi[field] += hasHanzi;
+            tones[field] += hasTones;
+            latin[field] += hasLatin;
+        }
+    }
+    auto best = [](const std::vector<int>& counts, int skip) {
+        int found = -1;
+        for (int field = 0; field < (int)counts.size(); field++) {
+            if (field != skip && counts[field] > 0 && (found < 0 || counts[field] > counts[found])) {
+                found = field;
+            }
+        }
+        return found;
+    };
+    fieldFor[CARD_CHINESE] = best(hanzi, -1);
+    fieldFor[CARD_PINYIN] = best(tones, fieldFor[CARD_CHINESE]);
+    fieldFor[CARD_ENGLISH] = -1;
+    for (int field = 0; field < (int)latin.size() && fieldFor[CARD_ENGLISH] < 0; field++) {
+        if (field != fieldFor[CARD_PINYIN] && field != fieldFor[CARD_CHINESE] && latin[field] > 0) {
+            fieldFor[CARD_ENGLISH] = field;
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+typedef struct sqlite3 sqlite3;
+typedef struct sqlite3_stmt sqlite3_stmt;
+
+// Reads the notes of an Anki deck export (.apkg): a zip holding the collection as an SQLite
+// database, beside the media. The collection is inflated a block at a time into a temporary
+// file, which SQLite then reads through a small page cache, and notes come out one row at a
+// time, so memory stays bounded however many notes the deck has.
+class ApkgReader {
+public:
+    ~ApkgReader();
+
+    // Extracts the collection; false, with error() saying why, if there isn't one this can read
+    bool open(const char* path);
+    // The next note's fields as plain text: HTML and [sound:] tags dropped, entities decoded,
+    // line breaks turned to spaces. False after the last note.
+    bool next(std::vector<std::string>& fields);
+
+    const std::string& error() const { return message; }
+    uint64_t collectionBytes() const { return extracted; }
+
+private:
+    bool extract(FILE* zip, uint64_t offset, uint32_t method, uint64_t packedSize, uint32_t crc);
+    bool fail(const std::string& why);
+
+    std::string message;
+    std::string collectionPath;     // the temporary file, removed again by the destructor
+    sqlite3* database = nullptr;
+    sqlite3_stmt* notes = nullptr;
+    uint64_t extracted = 0;
+};
+
+// Which note field becomes each card text (by CardText), or -1 for none, guessed from a sample
+// of notes: the field with the most hanzi is the chinese, the one with the most tone marks the
+// pinyin, and the first other field with any latin letters the english
+void guessCardFields(const std::vector<std::vector<std::string>>& sample, int fieldFor[3]);
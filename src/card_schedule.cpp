@@ -0,0 +1,57 @@
+#include "card_schedule.h"
+#include <algorithm>
+#include <time.h>
+
+void CardSchedule::reset(uint32_t cards) {
+    status.assign(cards, UNDECIDED);
+    due.assign(cards, 0);
+    interval.assign(cards, 0);
+    ease.assign(cards, STARTING_EASE);
+    lapses.assign(cards, 0);
+}
+
+void CardSchedule::resetCard(CardId id) {
+    status[id] = UNDECIDED;
+    due[id] = 0;
+    interval[id] = 0;
+    ease[id] = STARTING_EASE;
+    lapses[id] = 0;
+}
+
+void CardSchedule::review(CardId id, bool correct, uint32_t today) {
+    if (correct) {
+        status[id] = CORRECT;
+        uint32_t next = interval[id] == 0 ? 1 : (uint32_t)interval[id] * ease[id] / 1000;
+        interval[id] = (uint16_t)std::min<uint32_t>(std::max<uint32_t>(next, interval[id] + 1u), UINT16_MAX);
+    } else {
+        status[id] = INCORRECT;
+        if (interval[id] > 0) {
+            lapses[id]++;
+        }
+        interval[id] = 0;
+        ease[id] = (uint16_t)std::max<int>(ease[id] - EASE_PENALTY, MINIMUM_EASE);
+    }
+    due[id] = today + interval[id];
+}
+
+// A byte compare per card, which the compiler turns into wide vector compares
+size_t CardSchedule::countStatus(CardStatus wanted) const {
+    size_t count = 0;
+    const uint8_t* statuses = status.data();
+    for (size_t i = 0; i < status.size(); i++) {
+        count += statuses[i] == wanted;
+    }
+    return count;
+}
+
+size_t CardSchedule::memoryBytes() const {
+    return status.capacity() + due.capacity() * sizeof(uint32_t)
+        + (interval.capacity() + ease.capacity() + lapses.capacity()) * sizeof(uint16_t);
+}
+
+uint32_t currentDay() {
+    time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    return (uint32_t)((now + local.tm_gmtoff) / 86400);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "card_store.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// One learner's progress through the library: the review columns that change as they answer,
+// indexed by the same ids as the shared CardStore. About 11 bytes per card, so a profile costs
+// a small fraction of the deck it studies.
+class CardSchedule {
+public:
+    static constexpr uint16_t STARTING_EASE = 2500;
+    static constexpr uint16_t MINIMUM_EASE = 1300;
+    static constexpr uint16_t EASE_PENALTY = 200;  // taken off per wrong answer
+
+    // Every card new and unseen
+    void reset(uint32_t cards);
+    void resetCard(CardId id);
+    uint32_t size() const { return (uint32_t)status.size(); }
+
+    // Records an answer: sets the status and schedules the next review. A known card's
+    // interval grows by its ease; a missed one is due again today and gets a little harder.
+    void review(CardId id, bool correct, uint32_t today);
+    size_t countStatus(CardStatus wanted) const;
+    size_t memoryBytes() const;
+
+    // Columns, indexed by id
+    std::vector<uint8_t> status;        // CardStatus of the latest answer
+    std::vector<uint32_t> due;          // day (since 1970) of the next review; 0 = never reviewed
+    std::vector<uint16_t> interval;     // days between the last two reviews
+    std::vector<uint16_t> ease;         // interval growth per correct answer, in thousandths
+    std::vector<uint16_t> lapses;       // times answered wrong after being learned
+};
+
+// Days since 1970 in local time, the unit of CardSchedule::due
+uint32_t currentDay();
@@ -0,0 +1,234 @@
+#include "card_stats.h"
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CARD_STATS_AVX2
+#endif
+
+const char* const intervalBucketNames[INTERVAL_BUCKETS] = { "new", "1 day", "2-6 days", "1-4 wk", "1-3 mo", "3-12 mo", "1 yr+" };
+
+// Smallest interval of buckets 1 and up; the kernels count intervals at or above each
+static const int THRESHOLDS = INTERVAL_BUCKETS - 1;
+static const uint16_t intervalThresholds[THRESHOLDS] = { 1, 2, 7, 30, 90, 365 };
+
+// Narrow-lane counters overflow after this many vectors: a byte lane gains at most one per
+// vector, a 16-bit lane at most two
+static const size_t BLOCK_VECTORS = 255;
+
+typedef struct RawCounts {
+    uint64_t correct;
+    uint64_t incorrect;
+    uint64_t unseen;
+    uint64_t due;
+    uint64_t atLeast[THRESHOLDS];
+    uint64_t lapses;
+} RawCounts;
+
+static void scalarCounts(const CardSchedule& schedule, size_t first, size_t last, uint32_t today, RawCounts& counts) {
+    for (size_t i = first; i < last; i++) {
+        counts.correct += schedule.status[i] == CORRECT;
+        counts.incorrect += schedule.status[i] == INCORRECT;
+        counts.unseen += schedule.due[i] == 0;
+        counts.due += schedule.due[i] != 0 && schedule.due[i] <= today;
+        for (int t = 0; t < THRESHOLDS; t++) {
+            counts.atLeast[t] += schedule.interval[i] >= intervalThresholds[t];
+        }
+        counts.lapses += schedule.lapses[i];
+    }
+}
+
+#if defined(__SSE2__)
+static uint64_t sse2Sum32(__m128i value) {
+    uint32_t lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, value);
+    return (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+// SSE2 only compares signed lanes, so unsigned values are compared with their top bit flipped.
+// "1 <= due <= today" is the single unsigned compare "due - 1 < today", since 0 - 1 wraps.
+// Returns how many cards from 'first' were counted; the rest are left for scalarCounts.
+static size_t sse2Counts(const CardSchedule& schedule, size_t first, size_t last, uint32_t today, RawCounts& counts) {
+    const size_t width = 16;
+    size_t vectors = (last - first) / width;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i correct = _mm_set1_epi8(CORRECT);
+    const __m128i incorrect = _mm_set1_epi8(INCORRECT);
+    const __m128i one32 = _mm_set1_epi32(1);
+    const __m128i bias32 = _mm_set1_epi32(INT32_MIN);
+    const __m128i todayBiased = _mm_set1_epi32((int32_t)(today ^ 0x80000000u));
+    const __m128i bias16 = _mm_set1_epi16(INT16_MIN);
+    const __m128i one16 = _mm_set1_epi16(1);
+    __m128i thresholds[THRESHOLDS];
+    for (int t = 0; t < THRESHOLDS; t++) {
+        thresholds[t] = _mm_set1_epi16((int16_t)((intervalThresholds[t] - 1) ^ 0x8000));
+    }
+
+    for (size_t block = 0; block < vectors; block += BLOCK_VECTORS) {
+        size_t blockEnd = std::min(vectors, block + BLOCK_VECTORS);
+        __m128i correctCount = zero, incorrectCount = zero;         // 8-bit lanes
+        __m128i unseenCount = zero, dueCount = zero, lapseSum = zero; // 32-bit lanes
+        __m128i atLeast[THRESHOLDS];                                // 16-bit lanes
+        for (int t = 0; t < THRESHOLDS; t++) {
+            atLeast[t] = zero;
+        }
+        for (size_t v = block; v < blockEnd; v++) {
+            size_t i = first + v * width;
+            __m128i status = _mm_loadu_si128((const __m128i*)(schedule.status.data() + i));
+            correctCount = _mm_sub_epi8(correctCount, _mm_cmpeq_epi8(status, correct));
+            incorrectCount = _mm_sub_epi8(incorrectCount, _mm_cmpeq_epi8(status, incorrect));
+            for (int part = 0; part < 4; part++) {
+                __m128i due = _mm_loadu_si128((const __m128i*)(schedule.due.data() + i + part * 4));
+                unseenCount = _mm_sub_epi32(unseenCount, _mm_cmpeq_epi32(due, zero));
+                __m128i sinceDue = _mm_xor_si128(_mm_sub_epi32(due, one32), bias32);
+                dueCount = _mm_sub_epi32(dueCount, _mm_cmpgt_epi32(todayBiased, sinceDue));
+            }
+            for (int part = 0; part < 2; part++) {
+                __m128i interval = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(schedule.interval.data() + i + part * 8)), bias16);
+                for (int t = 0; t < THRESHOLDS; t++) {
+                    atLeast[t] = _mm_sub_epi16(atLeast[t], _mm_cmpgt_epi16(interval, thresholds[t]));
+                }
+                __m128i lapses = _mm_loadu_si128((const __m128i*)(schedule.lapses.data() + i + part * 8));
+                lapseSum = _mm_add_epi32(lapseSum, _mm_add_epi32(_mm_unpacklo_epi16(lapses, zero), _mm_unpackhi_epi16(lapses, zero)));
+            }
+        }
+
+        uint64_t bytes[2];
+        _mm_storeu_si128((__m128i*)bytes, _mm_sad_epu8(correctCount, zero));
+        counts.correct += bytes[0] + bytes[1];
+        _mm_storeu_si128((__m128i*)bytes, _mm_sad_epu8(incorrectCount, zero));
+        counts.incorrect += bytes[0] + bytes[1];
+        counts.unseen += sse2Sum32(unseenCount);
+        counts.due += sse2Sum32(dueCount);
+        counts.lapses += sse2Sum32(lapseSum);
+        for (int t = 0; t < THRESHOLDS; t++) {
+            counts.atLeast[t] += sse2Sum32(_mm_madd_epi16(atLeast[t], one16));
+        }
+    }
+    return vectors * width;
+}
+#endif
+
+#if defined(CARD_STATS_AVX2)
+// The same kernel over 32 cards at a time, built for AVX2 whatever the compiler flags and
+// only called once the CPU is known to have it
+__attribute__((target("avx2")))
+static uint64_t avx2Sum32(__m256i value) {
+    uint32_t lanes[8];
+    _mm256_storeu_si256((__m256i*)lanes, value);
+    uint64_t sum = 0;
+    for (uint32_t lane : lanes) {
+        sum += lane;
+    }
+    return sum;
+}
+
+__attribute__((target("avx2")))
+static size_t avx2Counts(const CardSchedule& schedule, size_t first, size_t last, uint32_t today, RawCounts& counts) {
+    const size_t width = 32;
+    size_t vectors = (last - first) / width;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i correct = _mm256_set1_epi8(CORRECT);
+    const __m256i incorrect = _mm256_set1_epi8(INCORRECT);
+    const __m256i one32 = _mm256_set1_epi32(1);
+    const __m256i bias32 = _mm256_set1_epi32(INT32_MIN);
+    const __m256i todayBiased = _mm256_set1_epi32((int32_t)(today ^ 0x80000000u));
+    const __m256i bias16 = _mm256_set1_epi16(INT16_MIN);
+    const __m256i one16 = _mm256_set1_epi16(1);
+    __m256i thresholds[THRESHOLDS];
+    for (int t = 0; t < THRESHOLDS; t++) {
+        thresholds[t] = _mm256_set1_epi16((int16_t)((intervalThresholds[t] - 1) ^ 0x8000));
+    }
+
+    for (size_t block = 0; block < vectors; block += BLOCK_VECTORS) {
+        size_t blockEnd = std::min(vectors, block + BLOCK_VECTORS);
+        __m256i correctCount = zero, incorrectCount = zero;
+        __m256i unseenCount = zero, dueCount = zero, lapseSum = zero;
+        __m256i atLeast[THRESHOLDS];
+        for (int t = 0; t < THRESHOLDS; t++) {
+            atLeast[t] = zero;
+        }
+        for (size_t v = block; v < blockEnd; v++) {
+            size_t i = first + v * width;
+            __m256i status = _mm256_loadu_si256((const __m256i*)(schedule.status.data() + i));
+            correctCount = _mm256_sub_epi8(correctCount, _mm256_cmpeq_epi8(status, correct));
+            incorrectCount = _mm256_sub_epi8(incorrectCount, _mm256_cmpeq_epi8(status, incorrect));
+            for (int part = 0; part < 4; part++) {
+                __m256i due = _mm256_loadu_si256((const __m256i*)(schedule.due.data() + i + part * 8));
+                unseenCount = _mm256_sub_epi32(unseenCount, _mm256_cmpeq_epi32(due, zero));
+                __m256i sinceDue = _mm256_xor_si256(_mm256_sub_epi32(due, one32), bias32);
+                dueCount = _mm256_sub_epi32(dueCount, _mm256_cmpgt_epi32(todayBiased, sinceDue));
+            }
+            for (int part = 0; part < 2; part++) {
+                __m256i interval = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(schedule.interval.data() + i + part * 16)), bias16);
+                for (int t = 0; t < THRESHOLDS; t++) {
+                    atLeast[t] = _mm256_sub_epi16(atLeast[t], _mm256_cmpgt_epi16(interval, thresholds[t]));
+                }
+                __m256i lapses = _mm256_loadu_si256((const __m256i*)(schedule.lapses.data() + i + part * 16));
+                lapseSum = _mm256_add_epi32(lapseSum, _mm256_add_epi32(_mm256_unpacklo_epi16(lapses, zero), _mm256_unpackhi_epi16(lapses, zero)));
+            }
+        }
+
+        uint64_t quads[4];
+        _mm256_storeu_si256((__m256i*)quads, _mm256_sad_epu8(correctCount, zero));
+        counts.correct += quads[0] + quads[1] + quads[2] + quads[3];
+        _mm256_storeu_si256((__m256i*)quads, _mm256_sad_epu8(incorrectCount, zero));
+        counts.incorrect += quads[0] + quads[1] + quads[2] + quads[3];
+        counts.unseen += avx2Sum32(unseenCount);
+        counts.due += avx2Sum32(dueCount);
+        counts.lapses += avx2Sum32(lapseSum);
+        for (int t = 0; t < THRESHOLDS; t++) {
+            counts.atLeast[t] += avx2Sum32(_mm256_madd_epi16(atLeast[t], one16));
+        }
+    }
+    return vectors * width;
+}
+
+static bool hasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+void addCardStats(const CardSchedule& schedule, CardId first, CardId last, uint32_t today, CardStats& stats) {
+    RawCounts counts = {};
+    size_t counted = first;
+#if defined(CARD_STATS_AVX2)
+    if (hasAvx2()) {
+        counted += avx2Counts(schedule, counted, last, today, counts);
+    }
+#endif
+#if defined(__SSE2__)
+    counted += sse2Counts(schedule, counted, last, today, counts);
+#endif
+    scalarCounts(schedule, counted, last, today, counts);
+
+    uint64_t cards = last - first;
+    stats.cards += cards;
+    stats.status[CORRECT] += counts.correct;
+    stats.status[INCORRECT] += counts.incorrect;
+    stats.status[UNDECIDED] += cards - counts.correct - counts.incorrect;
+    stats.unseen += counts.unseen;
+    stats.due += counts.due;
+    stats.intervals[0] += cards - counts.atLeast[0];
+    for (int t = 1; t < THRESHOLDS; t++) {
+        stats.intervals[t] += counts.atLeast[t - 1] - counts.atLeast[t];
+    }
+    stats.intervals[THRESHOLDS] += counts.atLeast[THRESHOLDS - 1];
+    stats.lapses += counts.lapses;
+}
+
+void addCardStats(const CardStats& from, CardStats& to) {
+    to.cards += from.cards;
+    for (int i = 0; i < 3; i++) {
+        to.status[i] += from.status[i];
+    }
+    to.unseen += from.unseen;
+    to.due += from.due;
+    for (int i = 0; i < INTERVAL_BUCKETS; i++) {
+        to.intervals[i] += from.intervals[i];
+    }
+    to.lapses += from.lapses;
+}
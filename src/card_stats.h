@@ -0,0 +1,24 @@
+#pragma once
+
+#include "card_schedule.h"
+#include <stdint.h>
+
+// Review intervals are bucketed at 1 day, 2 days, a week, a month, a quarter and a year
+static const int INTERVAL_BUCKETS = 7;
+extern const char* const intervalBucketNames[INTERVAL_BUCKETS];
+
+// Counts over a range of cards, all gathered in one pass over the schedule's columns
+typedef struct CardStats {
+    uint64_t cards;
+    uint64_t status[3];                     // by CardStatus
+    uint64_t unseen;                        // never reviewed
+    uint64_t due;                           // reviewed and due today or earlier
+    uint64_t intervals[INTERVAL_BUCKETS];   // by current interval; unseen and relearning cards are in bucket 0
+    uint64_t lapses;
+} CardStats;
+
+// Adds the cards [first, last) to 'stats'. The columns are read with AVX2 where the CPU has
+// it and SSE2 otherwise, a vector of cards at a time; counters are kept in narrow lanes and
+// widened only every few hundred vectors.
+void addCardStats(const CardSchedule& schedule, CardId first, CardId last, uint32_t today, CardStats& stats);
+void addCardStats(const CardStats& from, CardStats& to);
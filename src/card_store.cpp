@@ -0,0 +1,162 @@
+#include "card_store.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+CardStore cardStore;
+
+static const char cardStoreMagic[4] = { 'F', 'C', 'C', 'S' };
+static const uint32_t cardStoreVersion = 1;
+
+// The mapped file: this header, then the lesson column, the three text columns and the pool,
+// laid out so every column is aligned where it lands
+typedef struct CardStoreHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t cardCount;
+    uint32_t poolSize;
+} CardStoreHeader;
+
+CardStore::~CardStore() {
+    if (mapping) {
+        munmap(mapping, mappingSize);
+    }
+}
+
+CardId CardStore::add(std::string_view english, std::string_view pinyin, std::string_view chinese, uint32_t lessonIndex) {
+    CardId id = cardCount;
+    std::string_view fields[3] = { english, pinyin, chinese };
+    for (int field = 0; field < 3; field++) {
+        TextRef ref;
+        ref.offset = (uint32_t)poolColumn.size();
+        ref.length = (uint32_t)fields[field].size();
+        poolColumn.insert(poolColumn.end(), fields[field].begin(), fields[field].end());
+        textColumns[field].push_back(ref);
+    }
+    lessonColumn.push_back(lessonIndex);
+    cardCount++;
+    setPointers();
+    return id;
+}
+
+void CardStore::setPointers() {
+    if (mapping) {
+        const char* p = (const char*)mapping + sizeof(CardStoreHeader);
+        lessons = (const uint32_t*)p;
+        p += (size_t)cardCount * sizeof(uint32_t);
+        for (int field = 0; field < 3; field++) {
+            texts[field] = (const TextRef*)p;
+            p += (size_t)cardCount * sizeof(TextRef);
+        }
+        pool = p;
+    } else {
+        lessons = lessonColumn.data();
+        for (int field = 0; field < 3; field++) {
+            texts[field] = textColumns[field].data();
+        }
+        pool = poolColumn.data();
+    }
+}
+
+// Maps the whole of 'path' read-only, if it is 'size' bytes long
+static void* mapFile(const char* path, size_t size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    void* mapped = nullptr;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size == size) {
+        mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            mapped = nullptr;
+        }
+    }
+    close(fd);
+    return mapped;
+}
+
+bool CardStore::share(const char* path) {
+    if (mapping) {
+        return true;
+    }
+    CardStoreHeader header = {};
+    memcpy(header.magic, cardStoreMagic, sizeof(cardStoreMagic));
+    header.version = cardStoreVersion;
+    header.cardCount = cardCount;
+    header.poolSize = (uint32_t)poolColumn.size();
+    struct Section {
+        const void* data;
+        size_t size;
+    } sections[] = {
+        { &header, sizeof(header) },
+        { lessonColumn.data(), lessonColumn.size() * sizeof(uint32_t) },
+        { textColumns[CARD_ENGLISH].data(), textColumns[CARD_ENGLISH].size() * sizeof(TextRef) },
+        { textColumns[CARD_PINYIN].data(), textColumns[CARD_PINYIN].size() * sizeof(TextRef) },
+        { textColumns[CARD_CHINESE].data(), textColumns[CARD_CHINESE].size() * sizeof(TextRef) },
+        { poolColumn.data(), poolColumn.size() },
+    };
+    size_t size = 0;
+    for (const Section& section : sections) {
+        size += section.size;
+    }
+
+    // Another run on the same lessons left the same cards: map its file, so both share pages
+    void* mapped = mapFile(path, size);
+    if (mapped) {
+        const char* p = (const char*)mapped;
+        for (const Section& section : sections) {
+            if (memcmp(p, section.data, section.size) != 0) {
+                munmap(mapped, size);
+                mapped = nullptr;
+                break;
+            }
+            p += section.size;
+        }
+    }
+
+    // Otherwise write it beside and rename it over, so a process still mapping the old file
+    // keeps reading the old cards
+    if (!mapped) {
+        std::string temporary = std::string(path) + ".tmp" + std::to_string(getpid());
+        FILE* file = fopen(temporary.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        bool ok = true;
+        for (const Section& section : sections) {
+            ok = ok && fwrite(section.data, 1, section.size, file) == section.size;
+        }
+        ok = fclose(file) == 0 && ok;
+        if (!ok || rename(temporary.c_str(), path) != 0) {
+            remove(temporary.c_str());
+            return false;
+        }
+        mapped = mapFile(path, size);
+        if (!mapped) {
+            return false;
+        }
+    }
+
+    mapping = mapped;
+    mappingSize = size;
+    std::vector<char>().swap(poolColumn);
+    for (std::vector<TextRef>& column : textColumns) {
+        std::vector<TextRef>().swap(column);
+    }
+    std::vector<uint32_t>().swap(lessonColumn);
+    setPointers();
+    return true;
+}
+
+size_t CardStore::memoryBytes() const {
+    size_t bytes = poolColumn.capacity() + lessonColumn.capacity() * sizeof(uint32_t);
+    for (const std::vector<TextRef>& column : textColumns) {
+        bytes += column.capacity() * sizeof(TextRef);
+    }
+    return bytes;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+#include <vector>
+
+typedef uint32_t CardId;
+
+typedef enum CardStatus {
+    CORRECT,
+    INCORRECT,
+    UNDECIDED
+} CardStatus;
+
+typedef enum CardText {
+    CARD_ENGLISH,
+    CARD_PINYIN,
+    CARD_CHINESE
+} CardText;
+
+// Every card in the library, one column per field. A card's id is its index in every column,
+// assigned in load order and never reused, so sessions, indexes and the browser hold ids
+// rather than copies. Scans over one field (lessons, texts) touch only that column.
+//
+// The store only holds what the lessons say; each learner's answers are in a CardSchedule.
+// Once loaded, share() moves the columns into a read-only file mapping, which every profile
+// reads and any other process on the same library maps to the same pages.
+class CardStore {
+public:
+    ~CardStore();
+
+    // Text is copied into one pool; views returned by text() stay valid until the next add()
+    CardId add(std::string_view english, std::string_view pinyin, std::string_view chinese, uint32_t lesson);
+    uint32_t size() const { return cardCount; }
+
+    // Maps the columns from 'path', writing them there first unless the file already holds
+    // exactly these cards, and frees the loading copies. No more cards can be added. Returns
+    // false, and keeps the cards in memory, if the file couldn't be written or mapped.
+    bool share(const char* path);
+    bool shared() const { return mapping != nullptr; }
+
+    std::string_view text(CardText field, CardId id) const {
+        const TextRef& ref = texts[field][id];
+        return std::string_view(pool + ref.offset, ref.length);
+    }
+    std::string_view english(CardId id) const { return text(CARD_ENGLISH, id); }
+    std::string_view pinyin(CardId id) const { return text(CARD_PINYIN, id); }
+    std::string_view chinese(CardId id) const { return text(CARD_CHINESE, id); }
+    uint32_t lesson(CardId id) const { return lessons[id]; } // index into the lesson list
+
+    // Heap bytes; the shared mapping isn't counted
+    size_t memoryBytes() const;
+    size_t mappedBytes() const { return mappingSize; }
+
+private:
+    typedef struct TextRef {
+        uint32_t offset;
+        uint32_t length;
+    } TextRef;
+
+    void setPointers();
+
+    // Columns while loading; empty once shared
+    std::vector<char> poolColumn;
+    std::vector<TextRef> textColumns[3];    // by CardText
+    std::vector<uint32_t> lessonColumn;
+
+    // Where the columns are read from, in the vectors above or in the mapping
+    const char* pool = nullptr;
+    const TextRef* texts[3] = {};
+    const uint32_t* lessons = nullptr;
+    uint32_t cardCount = 0;
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+};
+
+extern CardStore cardStore;
@@ -0,0 +1,256 @@
+#include "confusables.h"
+#include "pinyin_index.h"
+#include "utf8.h"
+#include "parallel_sort.h"
+#include <algorithm>
+#include <thread>
+
+ConfusableIndex confusableIndex;
+
+// Field tags, so that the same bytes in two fields are different shingles
+static const uint64_t ENGLISH_SEED = 0x9E3779B97F4A7C15ull;
+static const uint64_t PINYIN_SEED = 0xC2B2AE3D27D4EB4Full;
+static const uint64_t CHINESE_SEED = 0x165667B19E3779F9ull;
+// Compare a new card with at most this many earlier cards of the same bucket. Buckets of
+// very common n-grams get huge, and the nearest earlier cards are usually the same lesson.
+static const size_t MAX_BUCKET_SCAN = 16;
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
+
+static uint64_t hashBytes(uint64_t seed, const char* bytes, size_t length) {
+    uint64_t hash = seed;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)bytes[i]) * 0x100000001B3ull;
+    }
+    return mix64(hash);
+}
+
+// Row i of the signature keeps the minimum of a different hash function of the shingles.
+// The functions are derived from one 64-bit hash (a + i * b, then scrambled), so each
+// shingle is hashed once rather than SIGNATURE_SIZE times.
+static void addShingle(uint64_t hash, uint32_t* signature) {
+    uint32_t a = (uint32_t)hash;
+    uint32_t b = (uint32_t)(hash >> 32) | 1;
+    for (int i = 0; i < ConfusableIndex::SIGNATURE_SIZE; i++) {
+        uint32_t value = (a + (uint32_t)i * b) * 0x9E3779B1u;
+        value ^= value >> 16;
+        signature[i] = std::min(signature[i], value);
+    }
+}
+
+// Trigrams of 'text', or the whole of it when shorter
+static void addTrigrams(const std::string& text, uint64_t seed, uint32_t* signature) {
+    if (text.empty()) {
+        return;
+    }
+    if (text.size() < 3) {
+        addShingle(hashBytes(seed, text.c_str(), text.size()), signature);
+        return;
+    }
+    for (size_t i = 0; i + 3 <= text.size(); i++) {
+        addShingle(hashBytes(seed, text.c_str() + i, 3), signature);
+    }
+}
+
+void ConfusableIndex::addCard(uint32_t id, const std::string& english, const std::string& pinyin, const std::string& chinese) {
+    cardCount = id + 1;
+    signatures.resize((size_t)cardCount * SIGNATURE_SIZE, UINT32_MAX);
+    uint32_t* signature = &signatures[(size_t)id * SIGNATURE_SIZE];
+
+    // Hanzi one and two at a time: 年 and 今年 share 年
+    codepoints.clear();
+    const char* p = chinese.c_str();
+    const char* end = p + chinese.size();
+    while (p < end) {
+        uint32_t c;
+        p += decodeUtf8(p, end, &c);
+        if (isHanziCodepoint(c)) {
+            codepoints.push_back(c);
+        }
+    }
+    for (size_t i = 0; i < codepoints.size(); i++) {
+        addShingle(mix64(CHINESE_SEED ^ codepoints[i]), signature);
+        if (i + 1 < codepoints.size()) {
+            addShingle(mix64(CHINESE_SEED ^ ((uint64_t)codepoints[i] << 32 | codepoints[i + 1])), signature);
+        }
+    }
+
+    // Pinyin without tones or spaces, since the tone is exactly what gets confused
+    static NormalizedPinyin normalized;
+    normalizePinyin(pinyin, normalized);
+    addTrigrams(normalized.letters, PINYIN_SEED, signature);
+
+    // English lowercased with single spaces, padded so word starts and ends count
+    std::string words = " ";
+    for (char ch : english) {
+        unsigned char c = (unsigned char)ch;
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80) {
+            words += (char)c;
+        } else if (words.back() != ' ') {
+            words += ' ';
+        }
+    }
+    if (words.back() != ' ') {
+        words += ' ';
+    }
+    if (words.size() > 1) {
+        addTrigrams(words, ENGLISH_SEED, signature);
+    }
+}
+
+float ConfusableIndex::similarity(uint32_t a, uint32_t b) const {
+    const uint32_t* x = &signatures[(size_t)a * SIGNATURE_SIZE];
+    const uint32_t* y = &signatures[(size_t)b * SIGNATURE_SIZE];
+    int same = 0;
+    for (int i = 0; i < SIGNATURE_SIZE; i++) {
+        same += x[i] == y[i];
+    }
+    return (float)same / SIGNATURE_SIZE;
+}
+
+void ConfusableIndex::commit() {
+    if (committedCount == cardCount) {
+        return;
+    }
+    const int bandCount = SIGNATURE_SIZE / BAND_ROWS;
+    auto byBucket = [](const BandEntry& a, const BandEntry& b) {
+        return a.bucket != b.bucket ? a.bucket < b.bucket : a.card < b.card;
+    };
+    // where each new card landed in each band, to find its bucket neighbors
+    std::vector<uint32_t> where((size_t)(cardCount - committedCount) * bandCount, UINT32_MAX);
+    for (int band = 0; band < bandCount; band++) {
+        std::vector<BandEntry>& entries = bands[band];
+        size_t oldSize = entries.size();
+        for (uint32_t card = committedCount; card < cardCount; card++) {
+            const uint32_t* rows = &signatures[(size_t)card * SIGNATURE_SIZE];
+            if (rows[0] == UINT32_MAX && rows[1] == UINT32_MAX) {
+                continue; // no text to compare
+            }
+            uint64_t hash = band;
+            for (int row = band * BAND_ROWS; row < (band + 1) * BAND_ROWS; row++) {
+                hash = mix64(hash ^ rows[row]);
+            }
+            BandEntry entry;
+            entry.bucket = (uint32_t)hash;
+            entry.card = card;
+            entries.push_back(entry);
+        }
+        // the old entries are sorted already, so only the new ones need sorting before a merge
+        std::sort(entries.begin() + oldSize, entries.end(), byBucket);
+        std::inplace_merge(entries.begin(), entries.begin() + oldSize, entries.end(), byBucket);
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (entries[i].card >= committedCount) {
+                where[(size_t)(entries[i].card - committedCount) * bandCount + band] = (uint32_t)i;
+            }
+        }
+    }
+
+    // Each new card compares itself with the earlier cards of its buckets and keeps only its
+    // best few, so a library full of near-duplicates doesn't pile up pairs. New cards always
+    // sort after old ones in a bucket, so every pair involving a new card is seen once per band.
+    uint32_t newCount = cardCount - committedCount;
+    std::vector<std::vector<Pair>> found(std::thread::hardware_concurrency() + 1);
+    parallelChunks(newCount, 4096, [&](size_t chunk, size_t begin, size_t end) {
+        std::vector<Pair>& out = found[chunk];
+        std::vector<uint32_t> others;
+        std::vector<Pair> candidates;
+        for (size_t n = begin; n < end; n++) {
+            uint32_t card = committedCount + (uint32_t)n;
+            others.clear();
+            for (int band = 0; band < bandCount; band++) {
+                uint32_t i = where[n * bandCount + band];
+                if (i == UINT32_MAX) {
+                    continue;
+                }
+                const std::vector<BandEntry>& entries = bands[band];
+                for (size_t j = i; j > 0 && i - j < MAX_BUCKET_SCAN && entries[j - 1].bucket == entries[i].bucket; j--) {
+                    others.push_back(entries[j - 1].card);
+                }
+            }
+            // close cards share several bands; score each once
+            std::sort(others.begin(), others.end());
+            others.erase(std::unique(others.begin(), others.end()), others.end());
+            candidates.clear();
+            for (uint32_t other : others) {
+                float s = similarity(card, other);
+                if (s >= MIN_SIMILARITY) {
+                    candidates.push_back({ card, other, s });
+                }
+            }
+            size_t best = std::min(candidates.size(), (size_t)MAX_NEIGHBORS);
+            std::partial_sort(candidates.begin(), candidates.begin() + best, candidates.end(), [](const Pair& a, const Pair& b) {
+                return a.similarity != b.similarity ? a.similarity > b.similarity : a.other < b.other;
+            });
+            for (size_t k = 0; k < best; k++) {
+                out.push_back(candidates[k]);
+                out.push_back({ candidates[k].other, card, candidates[k].similarity });
+            }
+        }
+    });
+    committedCount = cardCount;
+
+    // Merge the new pairs into the neighbor table: count per card, scatter the old lists
+    // and the new pairs into place, then keep each card's best MAX_NEIGHBORS. Whatever later
+    // commits add, a card's best are still among its kept ones and the new pairs.
+    std::vector<uint32_t> starts((size_t)cardCount + 1, 0);
+    for (uint32_t card = 0; card + 1 < neighborStarts.size(); card++) {
+        starts[card + 1] = neighborStarts[card + 1] - neighborStarts[card];
+    }
+    for (const std::vector<Pair>& chunkPairs : found) {
+        for (const Pair& pair : chunkPairs) {
+            starts[pair.card + 1]++;
+        }
+    }
+    for (uint32_t card = 0; card < cardCount; card++) {
+        starts[card + 1] += starts[card];
+    }
+    std::vector<ConfusableNeighbor> merged(starts[cardCount]);
+    std::vector<uint32_t> fill(starts.begin(), starts.end() - 1);
+    for (uint32_t card = 0; card + 1 < neighborStarts.size(); card++) {
+        for (uint32_t i = neighborStarts[card]; i < neighborStarts[card + 1]; i++) {
+            merged[fill[card]++] = neighborList[i];
+        }
+    }
+    for (const std::vector<Pair>& chunkPairs : found) {
+        for (const Pair& pair : chunkPairs) {
+            merged[fill[pair.card]++] = { pair.other, pair.similarity };
+        }
+    }
+
+    neighborStarts.assign((size_t)cardCount + 1, 0);
+    neighborList.clear();
+    for (uint32_t card = 0; card < cardCount; card++) {
+        ConfusableNeighbor* first = merged.data() + starts[card];
+        ConfusableNeighbor* last = merged.data() + starts[card + 1];
+        std::sort(first, last, [](const ConfusableNeighbor& a, const ConfusableNeighbor& b) {
+            return a.similarity != b.similarity ? a.similarity > b.similarity : a.card < b.card;
+        });
+        last = std::unique(first, last, [](const ConfusableNeighbor& a, const ConfusableNeighbor& b) {
+            return a.card == b.card;
+        });
+        if (last - first > MAX_NEIGHBORS) {
+            last = first + MAX_NEIGHBORS;
+        }
+        neighborList.insert(neighborList.end(), first, last);
+        neighborStarts[card + 1] = (uint32_t)neighborList.size();
+    }
+}
+
+ConfusableNeighbors ConfusableIndex::neighbors(uint32_t id) const {
+    ConfusableNeighbors result = { nullptr, nullptr };
+    if ((size_t)id + 1 < neighborStarts.size()) {
+        result.first = neighborList.data() + neighborStarts[id];
+        result.last = neighborList.data() + neighborStarts[id + 1];
+    }
+    return result;
+}
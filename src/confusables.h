@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+typedef struct ConfusableNeighbor {
+    uint32_t card;
+    float similarity; // estimated Jaccard similarity of the two cards' n-grams, 0 to 1
+} ConfusableNeighbor;
+
+typedef struct ConfusableNeighbors {
+    const ConfusableNeighbor* first;
+    const ConfusableNeighbor* last;
+    const ConfusableNeighbor* begin() const { return first; }
+    const ConfusableNeighbor* end() const { return last; }
+    size_t size() const { return last - first; }
+} ConfusableNeighbors;
+
+// Finds cards that look alike: 年 and 今年, "nián" and "niàn", "year" and "years old".
+// Each card gets a MinHash signature over the character n-grams of its three fields, and
+// locality-sensitive hashing on bands of the signature picks the pairs worth comparing, so
+// the library is never compared all against all. Cards are added as lessons load, in
+// ascending id order; commit() pairs the new ones with everything added so far, and can
+// wait until the neighbors are first wanted.
+class ConfusableIndex {
+public:
+    static const int SIGNATURE_SIZE = 16;
+    static const int BAND_ROWS = 2;             // signature rows hashed together into one LSH bucket
+    static const int MAX_NEIGHBORS = 8;         // most similar kept per card
+    static constexpr float MIN_SIMILARITY = 0.3f;
+
+    void addCard(uint32_t id, const std::string& english, const std::string& pinyin, const std::string& chinese);
+    void commit();
+
+    // Most similar first. Empty for cards added since the last commit().
+    ConfusableNeighbors neighbors(uint32_t id) const;
+
+private:
+    typedef struct BandEntry {
+        uint32_t bucket;
+        uint32_t card;
+    } BandEntry;
+    typedef struct Pair {
+        uint32_t card;
+        uint32_t other;
+        float similarity;
+    } Pair;
+
+    float similarity(uint32_t a, uint32_t b) const;
+
+    std::vector<uint32_t> signatures;   // SIGNATURE_SIZE per card
+    std::vector<BandEntry> bands[SIGNATURE_SIZE / BAND_ROWS]; // sorted by bucket up to committedCount
+    std::vector<uint32_t> neighborStarts; // per card, into neighborList; one extra at the end
+    std::vector<ConfusableNeighbor> neighborList;
+    uint32_t cardCount = 0;             // one past the highest id added
+    uint32_t committedCount = 0;
+    std::vector<uint32_t> codepoints;   // scratch for addCard()
+};
+
+extern ConfusableIndex confusableIndex;
@@ -0,0 +1,445 @@
+#include "dictionary.h"
+#include "utf8.h"
+#include <algorithm>
+#include <filesystem>
+#include <stdio.h>
+#include <string.h>
+
+Dictionary dictionary;
+
+static const char dictionaryMagic[4] = {'F', 'C', 'D', 'T'};
+static const uint32_t dictionaryVersion = 1;
+
+typedef struct DictionaryHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t nodeCount;
+    uint32_t groupCount;
+    uint32_t groupEntryCount;
+    uint32_t entryCount;
+    uint32_t textSize;
+} DictionaryHeader;
+
+// Vowels with tone marks 1-4, for "ni3" -> "nǐ"
+static const char* const markedVowels[][4] = {
+    { "ā", "á", "ǎ", "à" }, { "ē", "é", "ě", "è" }, { "ī", "í", "ǐ", "ì" },
+    { "ō", "ó", "ǒ", "ò" }, { "ū", "ú", "ǔ", "ù" }, { "ǖ", "ǘ", "ǚ", "ǜ" },
+    { "Ā", "Á", "Ǎ", "À" }, { "Ē", "É", "Ě", "È" }, { "Ō", "Ó", "Ǒ", "Ò" },
+};
+static const char lowerVowels[] = "aeiouv";
+static const char upperVowels[] = "AEO";
+
+// One CC-CEDICT syllable ("hao3", "lu:4", "Bei3", "ma5") with its tone as a mark. The mark
+// goes on a or e if there is one, on the o of "ou", and otherwise on the last vowel.
+static void appendMarkedSyllable(const std::string& syllable, std::string& out) {
+    std::string letters;
+    int tone = 0;
+    for (size_t i = 0; i < syllable.size(); i++) {
+        char c = syllable[i];
+        if (c >= '1' && c <= '5' && i + 1 == syllable.size()) {
+            tone = c - '0';
+        } else if (c == ':' && !letters.empty() && (letters.back() == 'u' || letters.back() == 'U')) {
+            letters.back() = letters.back() == 'u' ? 'v' : 'V';
+        } else {
+            letters += c;
+        }
+    }
+    int marked = -1;
+    for (size_t i = 0; i < letters.size() && marked < 0; i++) {
+        char c = letters[i] | 0x20;
+        if (c == 'a' || c == 'e') {
+            marked = (int)i;
+        }
+    }
+    for (size_t i = 0; i + 1 < letters.size() && marked < 0; i++) {
+        if ((letters[i] | 0x20) == 'o' && (letters[i + 1] | 0x20) == 'u') {
+            marked = (int)i;
+        }
+    }
+    for (size_t i = letters.size(); i-- > 0 && marked < 0;) {
+        if (strchr(lowerVowels, letters[i] | 0x20)) {
+            marked = (int)i;
+        }
+    }
+    for (size_t i = 0; i < letters.size(); i++) {
+        char c = letters[i];
+        const char* upper = strchr(upperVowels, c);
+        if ((int)i == marked && tone >= 1 && tone <= 4 && upper) {
+            out += markedVowels[6 + (upper - upperVowels)][tone - 1];
+        } else if ((int)i == marked && tone >= 1 && tone <= 4) {
+            out += markedVowels[strchr(lowerVowels, c | 0x20) - lowerVowels][tone - 1];
+        } else if (c == 'v' || c == 'V') {
+            out += c == 'v' ? "ü" : "Ü";
+        } else {
+            out += c;
+        }
+    }
+}
+
+// Lines look like: 朋友 朋友 [peng2 you5] /friend/CL:個|个[ge4],位[wei4]/
+bool Dictionary::parse(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    std::vector<std::pair<std::string, uint32_t>> keys; // headword, entry
+    std::string entryTextPool;
+    std::vector<uint32_t> offsets;
+    char line[4096];
+    std::string pinyin;
+    std::string english;
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == '#') {
+            continue;
+        }
+        char* traditionalEnd = strchr(line, ' ');
+        char* simplifiedEnd = traditionalEnd ? strchr(traditionalEnd + 1, ' ') : nullptr;
+        char* pinyinStart = simplifiedEnd ? strchr(simplifiedEnd, '[') : nullptr;
+        char* pinyinEnd = pinyinStart ? strchr(pinyinStart, ']') : nullptr;
+        char* glosses = pinyinEnd ? strchr(pinyinEnd, '/') : nullptr;
+        if (!glosses) {
+            continue;
+        }
+
+        pinyin.clear();
+        const char* p = pinyinStart + 1;
+        while (p < pinyinEnd) {
+            const char* space = p;
+            while (space < pinyinEnd && *space != ' ') {
+                space++;
+            }
+            appendMarkedSyllable(std::string(p, space), pinyin);
+            p = space + 1;
+        }
+        english.clear();
+        for (char* gloss = glosses + 1; *gloss && *gloss != '\n' && *gloss != '\r';) {
+            char* glossEnd = strchr(gloss, '/');
+            if (!glossEnd) {
+                break;
+            }
+            // measure words are notes for the learner rather than meanings
+            if (glossEnd > gloss && strncmp(gloss, "CL:", 3) != 0) {
+                if (!english.empty()) {
+                    english += "; ";
+                }
+                english.append(gloss, glossEnd);
+            }
+            gloss = glossEnd + 1;
+        }
+
+        uint32_t entry = (uint32_t)offsets.size() / 2;
+        offsets.push_back((uint32_t)entryTextPool.size());
+        entryTextPool.append(pinyin.c_str(), pinyin.size() + 1);
+        offsets.push_back((uint32_t)entryTextPool.size());
+        entryTextPool.append(english.c_str(), english.size() + 1);
+        std::string traditional(line, traditionalEnd);
+        std::string simplified(traditionalEnd + 1, simplifiedEnd);
+        if (simplified.empty() || traditional.empty()) {
+            continue;
+        }
+        keys.emplace_back(simplified, entry);
+        if (traditional != simplified) {
+            keys.emplace_back(traditional, entry);
+        }
+    }
+    fclose(file);
+    if (keys.empty()) {
+        return false;
+    }
+
+    entriesSize = (uint32_t)offsets.size() / 2;
+    textSize = (uint32_t)entryTextPool.size();
+    build(keys);
+    // build() laid out the trie and groups; the entries and text go at the end
+    size_t tail = storage.size();
+    storage.resize(tail + offsets.size() * sizeof(uint32_t) + textSize);
+    memcpy(storage.data() + tail, offsets.data(), offsets.size() * sizeof(uint32_t));
+    memcpy(storage.data() + tail + offsets.size() * sizeof(uint32_t), entryTextPool.data(), textSize);
+    DictionaryHeader* header = (DictionaryHeader*)storage.data();
+    header->entryCount = entriesSize;
+    header->textSize = textSize;
+    setPointers();
+    return true;
+}
+
+// Standard double-array construction: each node's children are placed at the first base
+// where every child slot is free, depth first over the sorted headwords.
+void Dictionary::build(std::vector<std::pair<std::string, uint32_t>>& keys) {
+    std::sort(keys.begin(), keys.end());
+    std::vector<std::string> words;
+    std::vector<uint32_t> starts;
+    std::vector<uint32_t> groupList;
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (i == 0 || keys[i].first != keys[i - 1].first) {
+            words.push_back(keys[i].first);
+            starts.push_back((uint32_t)groupList.size());
+        }
+        if (i == 0 || keys[i] != keys[i - 1]) {
+            groupList.push_back(keys[i].second);
+        }
+    }
+    starts.push_back((uint32_t)groupList.size());
+
+    std::vector<int32_t> bases(1024, 0);
+    std::vector<int32_t> checks(1024, -1);
+    checks[0] = 0; // the root
+    size_t nextFree = 1;
+    size_t used = 1;
+    std::vector<int> codes;
+
+    struct Range {
+        int32_t node;
+        uint32_t begin;
+        uint32_t end;
+        uint32_t depth;
+    };
+    std::vector<Range> pending;
+    pending.push_back({ 0, 0, (uint32_t)words.size(), 0 });
+    while (!pending.empty()) {
+        Range range = pending.back();
+        pending.pop_back();
+
+        // children codes: 0 for a word ending here, byte + 1 otherwise; ascending, as the words are sorted
+        codes.clear();
+        for (uint32_t i = range.begin; i < range.end; i++) {
+            const std::string& word = words[i];
+            int code = range.depth < word.size() ? (unsigned char)word[range.depth] + 1 : 0;
+            if (codes.empty() || codes.back() != code) {
+                codes.push_back(code);
+            }
+        }
+
+        size_t position = std::max(nextFree, (size_t)codes[0] + 1);
+        int32_t found = 0;
+        size_t occupied = 0;
+        for (;; position++) {
+            if (position + 257 > checks.size()) {
+                checks.resize(checks.size() * 2, -1);
+                bases.resize(checks.size(), 0);
+            }
+            if (checks[position] != -1) {
+                occupied++;
+                continue;
+            }
+            int32_t candidate = (int32_t)(position - codes[0]);
+            bool fits = true;
+            for (size_t k = 1; k < codes.size() && fits; k++) {
+                fits = checks[candidate + codes[k]] == -1;
+            }
+            if (fits) {
+                found = candidate;
+                break;
+            }
+        }
+        // skip the densely packed front on later searches, as it rarely has room
+        if (occupied * 20 >= (position - nextFree + 1) * 19) {
+            nextFree = position;
+        }
+        bases[range.node] = found;
+        for (int code : codes) {
+            checks[found + code] = range.node;
+            used = std::max(used, (size_t)found + code + 1);
+        }
+
+        // push in reverse so the lowest code is built first
+        uint32_t end = range.end;
+        for (size_t k = codes.size(); k-- > 0;) {
+            uint32_t begin = end;
+            while (begin > range.begin) {
+                const std::string& word = words[begin - 1];
+                int code = range.depth < word.size() ? (unsigned char)word[range.depth] + 1 : 0;
+                if (code != codes[k]) {
+                    break;
+                }
+                begin--;
+            }
+            if (codes[k] == 0) {
+                bases[found] = -(int32_t)begin - 1; // a word ending: its index is the group
+            } else {
+                pending.push_back({ found + codes[k], begin, end, range.depth + 1 });
+            }
+            end = begin;
+        }
+    }
+    while (nextFree < used && checks[nextFree] != -1) {
+        nextFree++;
+    }
+
+    nodeCount = (uint32_t)used;
+    groupCount = (uint32_t)words.size();
+    groupEntryCount = (uint32_t)groupList.size();
+    storage.resize(sizeof(DictionaryHeader) + (size_t)nodeCount * 8 + (groupCount + 1 + groupEntryCount) * 4);
+    DictionaryHeader* header = (DictionaryHeader*)storage.data();
+    memcpy(header->magic, dictionaryMagic, sizeof(dictionaryMagic));
+    header->version = dictionaryVersion;
+    header->nodeCount = nodeCount;
+    header->groupCount = groupCount;
+    header->groupEntryCount = groupEntryCount;
+    char* out = storage.data() + sizeof(DictionaryHeader);
+    memcpy(out, bases.data(), (size_t)nodeCount * 4);
+    out += (size_t)nodeCount * 4;
+    memcpy(out, checks.data(), (size_t)nodeCount * 4);
+    out += (size_t)nodeCount * 4;
+    memcpy(out, starts.data(), (groupCount + 1) * 4);
+    out += (groupCount + 1) * 4;
+    memcpy(out, groupList.data(), groupEntryCount * 4);
+}
+
+void Dictionary::setPointers() {
+    const char* p = storage.data() + sizeof(DictionaryHeader);
+    base = (const int32_t*)p;
+    p += (size_t)nodeCount * 4;
+    check = (const int32_t*)p;
+    p += (size_t)nodeCount * 4;
+    groupStarts = (const uint32_t*)p;
+    p += (groupCount + 1) * 4;
+    groupEntries = (const uint32_t*)p;
+    p += groupEntryCount * 4;
+    entryText = (const uint32_t*)p;
+    p += (size_t)entriesSize * 8;
+    text = p;
+    entries.resize(entriesSize);
+    for (uint32_t i = 0; i < entriesSize; i++) {
+        entries[i].pinyin = text + entryText[2 * i];
+        entries[i].english = text + entryText[2 * i + 1];
+    }
+}
+
+bool Dictionary::save(const char* path) const {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(storage.data(), 1, storage.size(), file) == storage.size();
+    return fclose(file) == 0 && ok;
+}
+
+bool Dictionary::loadCache(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    DictionaryHeader header;
+    bool ok = size >= (long)sizeof(header) && fread(&header, sizeof(header), 1, file) == 1
+        && memcmp(header.magic, dictionaryMagic, sizeof(dictionaryMagic)) == 0
+        && header.version == dictionaryVersion
+        && (uint64_t)size == sizeof(header) + (uint64_t)header.nodeCount * 8
+            + ((uint64_t)header.groupCount + 1 + header.groupEntryCount) * 4
+            + (uint64_t)header.entryCount * 8 + header.textSize;
+    if (ok) {
+        storage.resize(size);
+        fseek(file, 0, SEEK_SET);
+        ok = fread(storage.data(), 1, size, file) == (size_t)size;
+    }
+    fclose(file);
+    if (!ok) {
+        storage.clear();
+        return false;
+    }
+    nodeCount = header.nodeCount;
+    groupCount = header.groupCount;
+    groupEntryCount = header.groupEntryCount;
+    entriesSize = header.entryCount;
+    textSize = header.textSize;
+    setPointers();
+    return true;
+}
+
+bool Dictionary::load(const char* cedictPath, const char* cachePath) {
+    std::error_code error;
+    bool haveText = std::filesystem::exists(cedictPath, error);
+    bool cacheFresh = std::filesystem::exists(cachePath, error)
+        && (!haveText || std::filesystem::last_write_time(cachePath, error) >= std::filesystem::last_write_time(cedictPath, error));
+    if (cacheFresh && loadCache(cachePath)) {
+        return true;
+    }
+    if (!haveText || !parse(cedictPath)) {
+        return false;
+    }
+    if (!save(cachePath)) {
+        printf("Warning: could not write dictionary cache %s\n", cachePath);
+    }
+    return true;
+}
+
+int32_t Dictionary::walk(const char* word, size_t length) const {
+    uint32_t node = 0;
+    for (size_t i = 0; i < length; i++) {
+        uint32_t next = (uint32_t)(base[node] + (unsigned char)word[i] + 1);
+        if (next >= nodeCount || check[next] != (int32_t)node) {
+            return -1;
+        }
+        node = next;
+    }
+    return (int32_t)node;
+}
+
+size_t Dictionary::lookup(const char* word, size_t length, const uint32_t** ids) const {
+    if (!loaded()) {
+        return 0;
+    }
+    int32_t node = walk(word, length);
+    if (node < 0) {
+        return 0;
+    }
+    uint32_t end = (uint32_t)base[node];
+    if (end >= nodeCount || check[end] != node) {
+        return 0;
+    }
+    return wordEntries(end, ids);
+}
+
+size_t Dictionary::wordEntries(uint32_t word, const uint32_t** ids) const {
+    uint32_t group = (uint32_t)(-base[word] - 1);
+    *ids = groupEntries + groupStarts[group];
+    return groupStarts[group + 1] - groupStarts[group];
+}
+
+// Each node's parent is its check, and the byte that led to it is its offset from the parent's base
+std::string Dictionary::headword(uint32_t word) const {
+    std::string bytes;
+    for (uint32_t node = (uint32_t)check[word]; node != 0; node = (uint32_t)check[node]) {
+        bytes += (char)(node - base[check[node]] - 1);
+    }
+    std::reverse(bytes.begin(), bytes.end());
+    return bytes;
+}
+
+size_t Dictionary::longestPrefix(const char* word, size_t length) const {
+    size_t longest = 0;
+    forEachPrefix(word, length, [&](size_t prefixLength, uint32_t) { longest = prefixLength; });
+    return longest;
+}
+
+void Dictionary::fill(const std::string& chinese, std::string& pinyin, std::string& english) const {
+    if (!loaded() || chinese.empty() || (!pinyin.empty() && !english.empty())) {
+        return;
+    }
+    const uint32_t* ids;
+    if (lookup(chinese.c_str(), chinese.size(), &ids) > 0) {
+        if (pinyin.empty()) pinyin = entries[ids[0]].pinyin;
+        if (english.empty()) english = entries[ids[0]].english;
+        return;
+    }
+    if (!pinyin.empty()) {
+        return;
+    }
+    const char* p = chinese.c_str();
+    const char* end = p + chinese.size();
+    while (p < end) {
+        size_t length = longestPrefix(p, end - p);
+        if (length > 0 && lookup(p, length, &ids) > 0) {
+            if (!pinyin.empty()) {
+                pinyin += ' ';
+            }
+            pinyin += entries[ids[0]].pinyin;
+            p += length;
+        } else {
+            uint32_t c;
+            p += decodeUtf8(p, end, &c); // not in the dictionary; leave it out
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+typedef struct DictionaryEntry {
+    const char* pinyin;     // tone marks, syllables joined: "péngyou"
+    const char* english;    // glosses joined with "; "
+} DictionaryEntry;
+
+// CC-CEDICT, keyed by both simplified and traditional headwords in a double-array trie.
+// The text file is parsed once and the built trie is saved next to it; later runs load
+// that in one read. Once loaded nothing is modified, so any number of threads may look
+// words up at the same time without locks.
+class Dictionary {
+public:
+    // Loads 'cachePath' if it is newer than 'cedictPath', otherwise parses 'cedictPath'
+    // and writes the cache. Returns false if neither could be read.
+    bool load(const char* cedictPath, const char* cachePath);
+    bool loaded() const { return nodeCount != 0; }
+    size_t entryCount() const { return entriesSize; }
+
+    // Entries whose headword is exactly 'word', in file order: returns how many, with
+    // their ids in (*ids)[0..count)
+    size_t lookup(const char* word, size_t length, const uint32_t** ids) const;
+    const DictionaryEntry& entry(uint32_t id) const { return entries[id]; }
+    // Length in bytes of the longest headword that 'text' starts with, or 0
+    size_t longestPrefix(const char* text, size_t length) const;
+
+    // Calls fn(length, word) for every headword 'text' starts with, shortest first. 'word'
+    // identifies the headword, below wordLimit(), for counting; wordEntries() and headword()
+    // turn it back into entries and text.
+    template<typename Fn>
+    void forEachPrefix(const char* text, size_t length, Fn fn) const;
+    uint32_t wordLimit() const { return nodeCount; }
+    size_t wordEntries(uint32_t word, const uint32_t** ids) const;
+    std::string headword(uint32_t word) const;
+
+    // Fills in the card fields that are empty from the dictionary. English needs an exact
+    // headword; pinyin is also pieced together from the longest words the text splits into.
+    void fill(const std::string& chinese, std::string& pinyin, std::string& english) const;
+
+private:
+    bool parse(const char* path);
+    bool save(const char* path) const;
+    bool loadCache(const char* path);
+    void build(std::vector<std::pair<std::string, uint32_t>>& keys);
+    int32_t walk(const char* text, size_t length) const;
+    void setPointers();
+
+    // Trie: node s has the child for byte c at t = base[s] + c + 1 when check[t] == s. A key's
+    // end is the child at base[s] + 0, whose base is -(group + 1).
+    std::vector<char> storage;      // everything below, as read from or written to the cache
+    const int32_t* base = nullptr;
+    const int32_t* check = nullptr;
+    const uint32_t* groupStarts = nullptr;  // per headword, into groupEntries; one extra at the end
+    const uint32_t* groupEntries = nullptr;
+    const uint32_t* entryText = nullptr;    // pinyin and English offsets into text, per entry
+    const char* text = nullptr;
+    uint32_t nodeCount = 0;
+    uint32_t groupCount = 0;
+    uint32_t groupEntryCount = 0;
+    uint32_t entriesSize = 0;
+    uint32_t textSize = 0;
+    std::vector<DictionaryEntry> entries; // resolved pointers, what lookup() hands out
+};
+
+template<typename Fn>
+void Dictionary::forEachPrefix(const char* text, size_t length, Fn fn) const {
+    if (!loaded()) {
+        return;
+    }
+    uint32_t node = 0;
+    for (size_t i = 0; i < length; i++) {
+        uint32_t next = (uint32_t)(base[node] + (unsigned char)text[i] + 1);
+        if (next >= nodeCount || check[next] != (int32_t)node) {
+            return;
+        }
+        node = next;
+        uint32_t end = (uint32_t)base[node];
+        if (end < nodeCount && check[end] == (int32_t)node) {
+            fn(i + 1, end);
+        }
+    }
+}
+
+extern Dictionary dictionary;
@@ -0,0 +1,73 @@
+#include "english_index.h"
+#include <algorithm>
+
+EnglishIndex englishIndex;
+
+// Words are runs of ASCII letters and digits, lowercased. Bytes of multi-byte
+// UTF-8 sequences count as letters, so accented words stay whole.
+template<typename Fn>
+void EnglishIndex::forEachWord(const std::string& text, Fn fn) {
+    std::string word;
+    for (size_t i = 0; i <= text.size(); i++) {
+        unsigned char c = i < text.size() ? (unsigned char)text[i] : ' ';
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80) {
+            word += (char)c;
+        } else if (c >= 'A' && c <= 'Z') {
+            word += (char)(c - 'A' + 'a');
+        } else if (!word.empty()) {
+            fn(word);
+            word.clear();
+        }
+    }
+}
+
+void EnglishIndex::addCard(uint32_t id, const std::string& english) {
+    forEachWord(english, [&](const std::string& word) {
+        auto inserted = termIds.emplace(word, (uint32_t)terms.size());
+        if (inserted.second) {
+            terms.push_back(word);
+            postings.emplace_back();
+        }
+        postings[inserted.first->second].add(id);
+    });
+    cardCount = std::max(cardCount, id + 1);
+}
+
+void EnglishIndex::commit() {
+    if (sortedTerms.size() == terms.size()) {
+        return;
+    }
+    sortedTerms.resize(terms.size());
+    for (uint32_t i = 0; i < sortedTerms.size(); i++) {
+        sortedTerms[i] = i;
+    }
+    std::sort(sortedTerms.begin(), sortedTerms.end(), [this](uint32_t a, uint32_t b) { return terms[a] < terms[b]; });
+}
+
+void EnglishIndex::matchPrefix(const std::string& prefix, CardSet& cards) {
+    auto first = std::lower_bound(sortedTerms.begin(), sortedTerms.end(), prefix,
+        [this](uint32_t term, const std::string& p) { return terms[term] < p; });
+    for (auto it = first; it != sortedTerms.end() && terms[*it].compare(0, prefix.size(), prefix) == 0; ++it) {
+        postings[*it].forEach([&](uint32_t id) { cards.insert(id); });
+    }
+}
+
+bool EnglishIndex::search(const std::string& query, std::vector<uint32_t>& out) {
+    commit();
+    out.clear();
+    bool first = true;
+    forEachWord(query, [&](const std::string& word) {
+        CardSet& target = first ? matched : wordMatches;
+        target.reset(cardCount);
+        matchPrefix(word, target);
+        if (!first) {
+            matched.intersect(wordMatches);
+        }
+        first = false;
+    });
+    if (first) {
+        return false;
+    }
+    matched.collect(out);
+    return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "postings.h"
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Inverted index over the English side of every card: each lowercased word
+// maps to the ids of the cards containing it. Cards are added as lessons load,
+// with ids in ascending order.
+class EnglishIndex {
+public:
+    void addCard(uint32_t id, const std::string& english);
+    // Sorts the words added since the last call, for prefix lookups. Call after a batch
+    // of lessons loads, so the first search doesn't pay for it; search() does it if needed.
+    void commit();
+
+    // Cards containing, for every word of the query, some word starting with it
+    // ("ye" finds "year" and "yesterday"; "new ye" finds "new year").
+    // Returns false if the query has no words, in which case nothing was searched.
+    bool search(const std::string& query, std::vector<uint32_t>& out);
+
+private:
+    template<typename Fn>
+    static void forEachWord(const std::string& text, Fn fn);
+    // Marks the cards of every term starting with 'prefix'
+    void matchPrefix(const std::string& prefix, CardSet& cards);
+
+    std::unordered_map<std::string, uint32_t> termIds;
+    std::vector<std::string> terms;
+    std::vector<PostingList> postings;  // by term id
+    std::vector<uint32_t> sortedTerms;  // term ids in alphabetical order, for prefix lookups
+    uint32_t cardCount = 0;             // one past the highest id added
+    CardSet matched;
+    CardSet wordMatches;
+};
+
+extern EnglishIndex englishIndex;
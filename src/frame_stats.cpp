@@ -0,0 +1,64 @@
+#include "frame_stats.h"
+#include <stdio.h>
+#include <math.h>
+
+// 8 buckets per doubling, from 1/64 ms up to ~1 s
+static const int bucketsPerOctave = 8;
+static const double smallestBucketMs = 1.0 / 64.0;
+static const int numBuckets = 16 * bucketsPerOctave;
+
+FrameStats::FrameStats() : buckets(numBuckets, 0) {}
+
+int FrameStats::bucketFor(double ms) {
+    if (ms <= smallestBucketMs) {
+        return 0;
+    }
+    int bucket = (int)ceil(log2(ms / smallestBucketMs) * bucketsPerOctave);
+    return bucket < numBuckets ? bucket : numBuckets - 1;
+}
+
+double FrameStats::bucketUpperMs(int bucket) {
+    return smallestBucketMs * exp2((double)bucket / bucketsPerOctave);
+}
+
+void FrameStats::addFrame(double ms) {
+    buckets[bucketFor(ms)]++;
+    count++;
+    totalMs += ms;
+    if (ms > maxMs) {
+        maxMs = ms;
+    }
+}
+
+double FrameStats::percentileMs(double fraction) const {
+    uint64_t target = (uint64_t)ceil(fraction * count);
+    uint64_t seen = 0;
+    for (int i = 0; i < numBuckets; i++) {
+        seen += buckets[i];
+        if (seen >= target && seen > 0) {
+            double upper = bucketUpperMs(i);
+            return upper < maxMs ? upper : maxMs;
+        }
+    }
+    return maxMs;
+}
+
+void FrameStats::printSummary(const char* what) const {
+    printf("%d %s, %.3f ms average, p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, %.3f ms worst\n",
+        count, what, averageMs(), percentileMs(0.5), percentileMs(0.9), percentileMs(0.99), maxMs);
+}
+
+bool FrameStats::writeHistogram(const char* path) const {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        return false;
+    }
+    fprintf(f, "upper_ms,frames\n");
+    for (int i = 0; i < numBuckets; i++) {
+        if (buckets[i]) {
+            fprintf(f, "%.4f,%u\n", bucketUpperMs(i), buckets[i]);
+        }
+    }
+    fclose(f);
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Collects per-frame CPU times into a log-scale histogram so that runs of
+// different builds can be compared bucket by bucket
+class FrameStats {
+public:
+    FrameStats();
+
+    void addFrame(double ms);
+
+    int frames() const { return count; }
+    double averageMs() const { return count ? totalMs / count : 0.0; }
+    double worstMs() const { return maxMs; }
+    // Upper bound of the bucket holding the given fraction of frames (0.5 = median)
+    double percentileMs(double fraction) const;
+
+    void printSummary(const char* what = "frames") const;
+    bool writeHistogram(const char* path) const;
+
+private:
+    static int bucketFor(double ms);
+    static double bucketUpperMs(int bucket);
+
+    std::vector<uint32_t> buckets;
+    int count = 0;
+    double totalMs = 0.0;
+    double maxMs = 0.0;
+};
@@ -0,0 +1,82 @@
+#include "hanzi_index.h"
+#include "utf8.h"
+#include <algorithm>
+
+HanziIndex hanziIndex;
+
+void HanziIndex::addCard(uint32_t id, const std::string& chinese) {
+    const char* p = chinese.c_str();
+    const char* end = p + chinese.size();
+    while (p < end) {
+        uint32_t c;
+        p += decodeUtf8(p, end, &c);
+        if (isHanziCodepoint(c)) {
+            postings[c].add(id); // a repeated character adds the same id again, which is ignored
+        }
+    }
+}
+
+const PostingList* HanziIndex::find(uint32_t codepoint) const {
+    auto it = postings.find(codepoint);
+    return it == postings.end() ? nullptr : &it->second;
+}
+
+bool HanziIndex::search(const std::string& query, CardSet& cards) {
+    queryChars.clear();
+    bool any = false;
+    const char* p = query.c_str();
+    const char* end = p + query.size();
+    while (p < end) {
+        uint32_t c;
+        p += decodeUtf8(p, end, &c);
+        if (isHanziCodepoint(c)) {
+            queryChars.push_back(c);
+        } else if (c == '|') {
+            any = true;
+        }
+    }
+    if (queryChars.empty()) {
+        return false;
+    }
+
+    if (any) {
+        for (uint32_t c : queryChars) {
+            if (const PostingList* list = find(c)) {
+                list->forEach([&](uint32_t id) { cards.insert(id); });
+            }
+        }
+        return true;
+    }
+
+    // Start from the rarest character; every further one can only remove cards
+    std::vector<const PostingList*> lists;
+    for (uint32_t c : queryChars) {
+        const PostingList* list = find(c);
+        if (!list) {
+            return true; // a character no card has, so nothing matches
+        }
+        lists.push_back(list);
+    }
+    std::sort(lists.begin(), lists.end(), [](const PostingList* a, const PostingList* b) { return a->size() < b->size(); });
+    candidates.clear();
+    lists[0]->forEach([&](uint32_t id) { candidates.push_back(id); });
+    for (size_t i = 1; i < lists.size() && !candidates.empty(); i++) {
+        // both are ascending, so one merge pass keeps the candidates this list also has
+        size_t kept = 0;
+        size_t next = 0;
+        lists[i]->forEach([&](uint32_t id) {
+            while (next < candidates.size() && candidates[next] < id) {
+                next++;
+            }
+            if (next < candidates.size() && candidates[next] == id) {
+                candidates[kept++] = id;
+                next++;
+            }
+        });
+        candidates.resize(kept);
+    }
+    for (uint32_t id : candidates) {
+        cards.insert(id);
+    }
+    return true;
+}
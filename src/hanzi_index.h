@@ -0,0 +1,28 @@
+#pragma once
+
+#include "postings.h"
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Inverted index from each Chinese character (code point) to the cards whose
+// chinese field contains it. Cards are added as lessons load, in ascending id order.
+class HanziIndex {
+public:
+    void addCard(uint32_t id, const std::string& chinese);
+
+    // Marks in 'cards' the cards containing every character of the query ("年月"),
+    // or any of them if the query separates them with '|' ("年|月"). Characters that
+    // aren't hanzi are ignored. Returns false if the query has no hanzi.
+    bool search(const std::string& query, CardSet& cards);
+
+private:
+    const PostingList* find(uint32_t codepoint) const;
+
+    std::unordered_map<uint32_t, PostingList> postings;
+    std::vector<uint32_t> queryChars; // scratch for search()
+    std::vector<uint32_t> candidates;
+};
+
+extern HanziIndex hanziIndex;
@@ -0,0 +1,95 @@
+#include "lesson_deck.h"
+#include <string.h>
+
+static const char deckMagic[4] = { 'F', 'C', 'D', 'K' };
+static const uint32_t deckVersion = 1;
+
+typedef struct DeckHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t cardCount;
+    uint32_t textBytes;
+} DeckHeader;
+
+DeckWriter::~DeckWriter() {
+    if (file) {
+        fclose(file);
+    }
+}
+
+bool DeckWriter::open(const char* path) {
+    lengths.clear();
+    text.clear();
+    file = fopen(path, "wb");
+    return file != nullptr;
+}
+
+void DeckWriter::add(std::string_view english, std::string_view pinyin, std::string_view chinese) {
+    for (std::string_view field : { english, pinyin, chinese }) {
+        lengths.push_back((uint32_t)field.size());
+        text.insert(text.end(), field.begin(), field.end());
+    }
+}
+
+bool DeckWriter::close() {
+    if (!file) {
+        return false;
+    }
+    DeckHeader header = {};
+    memcpy(header.magic, deckMagic, sizeof(deckMagic));
+    header.version = deckVersion;
+    header.cardCount = (uint32_t)(lengths.size() / 3);
+    header.textBytes = (uint32_t)text.size();
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(lengths.data(), sizeof(uint32_t), lengths.size(), file) == lengths.size()
+        && fwrite(text.data(), 1, text.size(), file) == text.size();
+    ok = fclose(file) == 0 && ok;
+    file = nullptr;
+    return ok;
+}
+
+bool DeckReader::open(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data.resize(size > 0 ? (size_t)size : 0);
+    bool ok = fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    DeckHeader header;
+    if (!ok || data.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    size_t lengthBytes = (size_t)header.cardCount * 3 * sizeof(uint32_t);
+    if (memcmp(header.magic, deckMagic, sizeof(deckMagic)) != 0 || header.version != deckVersion
+        || data.size() != sizeof(header) + lengthBytes + header.textBytes) {
+        return false;
+    }
+    lengths = (const uint32_t*)(data.data() + sizeof(header));
+    text = data.data() + sizeof(header) + lengthBytes;
+    cardCount = header.cardCount;
+    card = 0;
+    // the lengths must stay inside the text, however the file was damaged
+    uint64_t total = 0;
+    for (size_t i = 0; i < (size_t)cardCount * 3; i++) {
+        total += lengths[i];
+    }
+    return total == header.textBytes;
+}
+
+bool DeckReader::next(std::string_view& english, std::string_view& pinyin, std::string_view& chinese) {
+    if (card == cardCount) {
+        return false;
+    }
+    std::string_view* fields[3] = { &english, &pinyin, &chinese };
+    for (std::string_view* field : fields) {
+        *field = std::string_view(text, *lengths);
+        text += *lengths++;
+    }
+    card++;
+    return true;
+}
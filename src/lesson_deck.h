@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string_view>
+#include <vector>
+
+// A lesson packed for loading without parsing: a header, each card's three text lengths,
+// then all the text, so it's one read and no line or comma splitting. The loader takes
+// lessonN.deck in place of lessonN.csv; importers write either.
+class DeckWriter {
+public:
+    ~DeckWriter();
+
+    bool open(const char* path);
+    void add(std::string_view english, std::string_view pinyin, std::string_view chinese);
+    // Writes the cards added since open(); false if the file couldn't be written
+    bool close();
+
+private:
+    FILE* file = nullptr;
+    std::vector<uint32_t> lengths;
+    std::vector<char> text;
+};
+
+class DeckReader {
+public:
+    // Reads the whole of 'path'; false if it isn't a deck
+    bool open(const char* path);
+    bool next(std::string_view& english, std::string_view& pinyin, std::string_view& chinese);
+
+private:
+    std::vector<char> data;
+    const uint32_t* lengths = nullptr;
+    const char* text = nullptr;
+    uint32_t cardCount = 0;
+    uint32_t card = 0;
+};
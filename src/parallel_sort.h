@@ -0,0 +1,123 @@
+#pragma once
+
+#include "alloc_profiler.h"
+#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+// Splits [0, count) into up to hardware_concurrency() contiguous chunks of at least
+// 'minChunk' items and runs fn(chunk, begin, end) for each, the first on the calling thread.
+// Returns the number of chunks used. The helper threads' allocations count against the
+// caller's subsystem.
+template<typename Fn>
+size_t parallelChunks(size_t count, size_t minChunk, Fn fn) {
+    size_t chunks = 1;
+    while (chunks * 2 <= std::thread::hardware_concurrency() && count / (chunks * 2) >= minChunk) {
+        chunks *= 2;
+    }
+    AllocSubsystem subsystem = currentAllocSubsystem();
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < chunks; i++) {
+        workers.emplace_back([=] {
+            AllocScope scope(subsystem);
+            fn(i, count * i / chunks, count * (i + 1) / chunks);
+        });
+    }
+    fn(0, 0, count / chunks);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    return chunks;
+}
+
+// Sorts [first, last) on several threads: each sorts a contiguous chunk, then neighbouring
+// chunks are merged pairwise in parallel. Not stable, so 'comp' should be a total order if
+// the result must be reproducible.
+template<typename RandomIt, typename Compare>
+void parallelSort(RandomIt first, RandomIt last, Compare comp) {
+    size_t count = last - first;
+    size_t chunks = parallelChunks(count, 16384, [=](size_t, size_t begin, size_t end) {
+        std::sort(first + begin, first + end, comp);
+    });
+    AllocSubsystem subsystem = currentAllocSubsystem();
+    for (size_t width = 1; width < chunks; width *= 2) {
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < chunks; i += 2 * width) {
+            RandomIt begin = first + count * i / chunks;
+            RandomIt middle = first + count * (i + width) / chunks;
+            RandomIt end = first + count * (i + 2 * width) / chunks;
+            workers.emplace_back([=] {
+                AllocScope scope(subsystem);
+                std::inplace_merge(begin, middle, end, comp);
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+}
+
+// Stable LSD radix sort of 'items' by the 64-bit key(item), one byte per pass. Each pass's
+// histogram and scatter are split across threads; passes where every key has the same byte
+// are skipped.
+// 'scratch' is resized to match and may be kept between calls to avoid reallocating.
+template<typename T, typename KeyFn>
+void parallelRadixSort(std::vector<T>& items, std::vector<T>& scratch, KeyFn key) {
+    size_t count = items.size();
+    scratch.resize(count);
+
+    // One read of the input finds, for every byte position at once, whether all keys share it;
+    // those passes are skipped. Which byte values occur doesn't depend on order.
+    std::vector<size_t> counts((std::thread::hardware_concurrency() + 1) * 8 * 256);
+    size_t chunks = parallelChunks(count, 65536, [&](size_t chunk, size_t begin, size_t end) {
+        size_t* chunkCounts = &counts[chunk * 8 * 256];
+        for (size_t i = begin; i < end; i++) {
+            uint64_t k = key(items[i]);
+            for (int pass = 0; pass < 8; pass++) {
+                chunkCounts[pass * 256 + ((k >> (pass * 8)) & 0xFF)]++;
+            }
+        }
+    });
+    bool trivial[8] = {};
+    for (int pass = 0; pass < 8; pass++) {
+        for (int digit = 0; digit < 256 && !trivial[pass]; digit++) {
+            size_t digitCount = 0;
+            for (size_t chunk = 0; chunk < chunks; chunk++) {
+                digitCount += counts[(chunk * 8 + pass) * 256 + digit];
+            }
+            trivial[pass] = digitCount == count;
+        }
+    }
+
+    std::vector<size_t> offsets(chunks * 256);
+    for (int pass = 0; pass < 8; pass++) {
+        if (trivial[pass]) {
+            continue;
+        }
+        // Each pass reorders the items, so a chunk's counts for this byte are taken from the
+        // items it holds now, over the same ranges the scatter below uses
+        parallelChunks(count, 65536, [&, pass](size_t chunk, size_t begin, size_t end) {
+            size_t* chunkCounts = &counts[chunk * 256];
+            std::fill(chunkCounts, chunkCounts + 256, 0);
+            for (size_t i = begin; i < end; i++) {
+                chunkCounts[(key(items[i]) >> (pass * 8)) & 0xFF]++;
+            }
+        });
+        size_t total = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            for (size_t chunk = 0; chunk < chunks; chunk++) {
+                offsets[chunk * 256 + digit] = total;
+                total += counts[chunk * 256 + digit];
+            }
+        }
+        parallelChunks(count, 65536, [&, pass](size_t chunk, size_t begin, size_t end) {
+            size_t* next = &offsets[chunk * 256];
+            for (size_t i = begin; i < end; i++) {
+                scratch[next[(key(items[i]) >> (pass * 8)) & 0xFF]++] = items[i];
+            }
+        });
+        items.swap(scratch);
+    }
+}
@@ -0,0 +1,513 @@
+#include "pinyin_audio.h"
+#include "alloc_profiler.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+PinyinAudio pinyinAudio;
+
+static const char clipPackMagic[4] = { 'F', 'C', 'A', 'P' };
+static const uint32_t clipPackVersion = 1;
+
+typedef struct ClipPackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t clipCount;
+    uint32_t sampleRate;
+} ClipPackHeader;
+
+// The longest syllables, "zhuang" and "shuang"
+static const uint32_t MAX_SYLLABLE_LETTERS = 6;
+// The device buffer is the largest power of two samples that plays in this long
+static const double DEVICE_BUFFER_MS = 6.0;
+
+static const int adpcmIndexTable[16] = { -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8 };
+static const int16_t adpcmStepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66,
+    73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449,
+    494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272,
+    2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493,
+    10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+// One 4-bit code applied to the decoder state; the encoder runs it too, to stay in step
+static inline int16_t adpcmStep(int nibble, int& predictor, int& stepIndex) {
+    int step = adpcmStepTable[stepIndex];
+    int difference = step >> 3;
+    if (nibble & 4) difference += step;
+    if (nibble & 2) difference += step >> 1;
+    if (nibble & 1) difference += step >> 2;
+    predictor += (nibble & 8) ? -difference : difference;
+    predictor = std::clamp(predictor, -32768, 32767);
+    stepIndex = std::clamp(stepIndex + adpcmIndexTable[nibble], 0, 88);
+    return (int16_t)predictor;
+}
+
+ClipPack::~ClipPack() {
+    if (mapping) {
+        munmap(mapping, mappingSize);
+    }
+}
+
+bool ClipPack::open(const char* path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    void* mapped = nullptr;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(ClipPackHeader)) {
+        mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (!mapped || mapped == MAP_FAILED) {
+        return false;
+    }
+    ClipPackHeader header;
+    memcpy(&header, mapped, sizeof(header));
+    size_t size = (size_t)info.st_size;
+    size_t indexEnd = sizeof(header) + (size_t)header.clipCount * sizeof(ClipEntry);
+    bool valid = memcmp(header.magic, clipPackMagic, sizeof(clipPackMagic)) == 0 && header.version == clipPackVersion
+        && header.sampleRate > 0 && indexEnd <= size;
+    const ClipEntry* index = (const ClipEntry*)((const char*)mapped + sizeof(header));
+    for (uint32_t i = 0; valid && i < header.clipCount; i++) {
+        // in 64 bits, so a huge sample count can't wrap around and pass
+        valid = index[i].offset >= indexEnd && (uint64_t)index[i].offset + ((uint64_t)index[i].samples + 1) / 2 <= size
+            && index[i].stepIndex <= 88 && index[i].name[MAX_NAME - 1] == '\0';
+    }
+    if (!valid) {
+        munmap(mapped, size);
+        return false;
+    }
+    mapping = mapped;
+    mappingSize = size;
+    entries = index;
+    clipCount = header.clipCount;
+    rate = header.sampleRate;
+    for (uint32_t i = 0; i < clipCount; i++) {
+        size_t length = strlen(entries[i].name);
+        if (length > 1) {
+            syllables.push_back(std::string_view(entries[i].name, length - 1));
+        }
+    }
+    std::sort(syllables.begin(), syllables.end());
+    syllables.erase(std::unique(syllables.begin(), syllables.end()), syllables.end());
+    return true;
+}
+
+int ClipPack::find(std::string_view name) const {
+    const ClipEntry* end = entries + clipCount;
+    const ClipEntry* found = std::lower_bound(entries, end, name, [](const ClipEntry& entry, std::string_view wanted) {
+        return std::string_view(entry.name) < wanted;
+    });
+    return found != end && std::string_view(found->name) == name ? (int)(found - entries) : -1;
+}
+
+bool ClipPack::hasSyllable(std::string_view letters) const {
+    return std::binary_search(syllables.begin(), syllables.end(), letters);
+}
+
+uint32_t ClipPack::sampleCount(int clip) const {
+    return entries[clip].samples;
+}
+
+void ClipPack::decode(int clip, std::vector<int16_t>& out) const {
+    const ClipEntry& entry = entries[clip];
+    const uint8_t* codes = (const uint8_t*)mapping + entry.offset;
+    int predictor = entry.predictor;
+    int stepIndex = entry.stepIndex;
+    size_t first = out.size();
+    out.resize(first + entry.samples);
+    int16_t* samples = out.data() + first;
+    // two samples a byte, the low nibble first
+    for (uint32_t i = 0; i + 1 < entry.samples; i += 2) {
+        uint8_t code = codes[i / 2];
+        samples[i] = adpcmStep(code & 0xF, predictor, stepIndex);
+        samples[i + 1] = adpcmStep(code >> 4, predictor, stepIndex);
+    }
+    if (entry.samples & 1) {
+        samples[entry.samples - 1] = adpcmStep(codes[entry.samples / 2] & 0xF, predictor, stepIndex);
+    }
+}
+
+// The samples of a 16-bit PCM WAV file, mixed down to mono
+static bool readWav(const std::filesystem::path& path, std::vector<int16_t>& samples, uint32_t& rate) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < 12 || memcmp(data.data(), "RIFF", 4) != 0 || memcmp(data.data() + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+    uint16_t format = 0, channels = 0, bits = 0;
+    for (size_t at = 12; at + 8 <= data.size();) {
+        uint32_t size;
+        memcpy(&size, data.data() + at + 4, 4);
+        const char* body = data.data() + at + 8;
+        if (size > data.size() - at - 8) {
+            return false;
+        }
+        if (memcmp(data.data() + at, "fmt ", 4) == 0 && size >= 16) {
+            memcpy(&format, body, 2);
+            memcpy(&channels, body + 2, 2);
+            memcpy(&rate, body + 4, 4);
+            memcpy(&bits, body + 14, 2);
+        } else if (memcmp(data.data() + at, "data", 4) == 0) {
+            if (format != 1 || bits != 16 || channels == 0) {
+                return false;
+            }
+            size_t frames = size / (2 * channels);
+            samples.resize(frames);
+            for (size_t frame = 0; frame < frames; frame++) {
+                int sum = 0;
+                for (uint16_t channel = 0; channel < channels; channel++) {
+                    int16_t sample;
+                    memcpy(&sample, body + (frame * channels + channel) * 2, 2);
+                    sum += sample;
+                }
+                samples[frame] = (int16_t)(sum / channels);
+            }
+            return true;
+        }
+        at += 8 + size + (size & 1);
+    }
+    return false;
+}
+
+bool writeClipPack(const char* directory, const char* path, std::string& error) {
+    typedef struct Clip {
+        std::string name;
+        std::vector<int16_t> samples;
+    } Clip;
+    std::vector<Clip> clips;
+    uint32_t rate = 0;
+    std::error_code listError;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, listError)) {
+        std::string name = entry.path().stem().string();
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)tolower(c); });
+        bool syllable = entry.path().extension() == ".wav" && name.size() >= 2 && name.size() < ClipPack::MAX_NAME
+            && name.back() >= '1' && name.back() <= '5'
+            && std::all_of(name.begin(), name.end() - 1, [](char c) { return c >= 'a' && c <= 'z'; });
+        if (!syllable) {
+            continue;
+        }
+        Clip clip;
+        clip.name = name;
+        uint32_t clipRate = 0;
+        if (!readWav(entry.path(), clip.samples, clipRate)) {
+            error = entry.path().string() + " isn't a 16-bit PCM WAV file";
+            return false;
+        }
+        if (rate != 0 && clipRate != rate) {
+            error = entry.path().string() + " is at " + std::to_string(clipRate) + " Hz, the others at " + std::to_string(rate);
+            return false;
+        }
+        rate = clipRate;
+        clips.push_back(std::move(clip));
+    }
+    if (clips.empty()) {
+        error = std::string("no syllable clips (like hao3.wav) in ") + directory;
+        return false;
+    }
+    std::sort(clips.begin(), clips.end(), [](const Clip& a, const Clip& b) { return a.name < b.name; });
+
+    ClipPackHeader header = {};
+    memcpy(header.magic, clipPackMagic, sizeof(clipPackMagic));
+    header.version = clipPackVersion;
+    header.clipCount = (uint32_t)clips.size();
+    header.sampleRate = rate;
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        error = std::string("could not write ") + path;
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    uint32_t offset = (uint32_t)(sizeof(header) + clips.size() * sizeof(ClipPack::ClipEntry));
+    for (const Clip& clip : clips) {
+        ClipPack::ClipEntry entry = {};
+        memcpy(entry.name, clip.name.data(), clip.name.size());
+        entry.offset = offset;
+        entry.samples = (uint32_t)clip.samples.size();
+        entry.predictor = entry.samples ? clip.samples[0] : 0;
+        ok = ok && fwrite(&entry, sizeof(entry), 1, file) == 1;
+        offset += (entry.samples + 1) / 2;
+    }
+    std::vector<uint8_t> codes;
+    for (const Clip& clip : clips) {
+        int predictor = clip.samples.empty() ? 0 : clip.samples[0];
+        int stepIndex = 0;
+        codes.assign((clip.samples.size() + 1) / 2, 0);
+        for (size_t i = 0; i < clip.samples.size(); i++) {
+            int difference = clip.samples[i] - predictor;
+            int nibble = difference < 0 ? 8 : 0;
+            difference = abs(difference);
+            int step = adpcmStepTable[stepIndex];
+            for (int bit = 4; bit > 0; bit >>= 1, step >>= 1) {
+                if (difference >= step) {
+                    nibble |= bit;
+                    difference -= step;
+                }
+            }
+            adpcmStep(nibble, predictor, stepIndex);
+            codes[i / 2] |= (uint8_t)(nibble << (i & 1 ? 4 : 0));
+        }
+        ok = ok && fwrite(codes.data(), 1, codes.size(), file) == codes.size();
+    }
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        error = std::string("could not write ") + path;
+    }
+    return ok;
+}
+
+PinyinAudio::~PinyinAudio() {
+    close();
+}
+
+bool PinyinAudio::open(const char* packPath) {
+    if (!pack.open(packPath)) {
+        return false;
+    }
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+        printf("Error: no audio: %s\n", SDL_GetError());
+        return false;
+    }
+    SDL_AudioSpec want = {};
+    want.freq = (int)pack.sampleRate();
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = 1;
+    while (want.samples * 2 <= pack.sampleRate() * DEVICE_BUFFER_MS / 1000.0) {
+        want.samples *= 2;
+    }
+    SDL_AudioSpec have;
+    device = SDL_OpenAudioDevice(nullptr, 0, &want, &have, 0); // SDL converts to what the device takes
+    if (device == 0) {
+        printf("Error: no audio: %s\n", SDL_GetError());
+        return false;
+    }
+    deviceBufferMs = 1000.0 * want.samples / want.freq;
+    SDL_PauseAudioDevice(device, 0);
+
+    // every buffer sized for the longest card up front, so the cache never reallocates
+    slots.resize(CACHE_SLOTS);
+    for (Slot& slot : slots) {
+        slot.pcm.reserve((size_t)pack.sampleRate() * MAX_CARD_SECONDS);
+    }
+    worker = std::thread(&PinyinAudio::run, this);
+    return true;
+}
+
+void PinyinAudio::close() {
+    if (!worker.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+    SDL_CloseAudioDevice(device);
+    device = 0;
+}
+
+bool PinyinAudio::cached(CardId card) const {
+    for (const Slot& slot : slots) {
+        if (slot.card == card) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The card waiting to be played, then the wanted ones in order
+CardId PinyinAudio::nextToDecode() const {
+    if (pendingPlay != NO_CARD && !cached(pendingPlay)) {
+        return pendingPlay;
+    }
+    for (size_t i = 0; i < wantedCount; i++) {
+        if (!cached(wanted[i])) {
+            return wanted[i];
+        }
+    }
+    return NO_CARD;
+}
+
+// An empty slot, or the least recently used one nobody is waiting for
+PinyinAudio::Slot& PinyinAudio::victim() {
+    Slot* oldest = nullptr;
+    for (Slot& slot : slots) {
+        if (slot.card == NO_CARD) {
+            return slot;
+        }
+        bool needed = slot.card == pendingPlay || std::find(wanted, wanted + wantedCount, slot.card) != wanted + wantedCount;
+        if (!needed && (!oldest || slot.lastUsed < oldest->lastUsed)) {
+            oldest = &slot;
+        }
+    }
+    return *oldest;
+}
+
+void PinyinAudio::prefetch(const CardId* cards, size_t count) {
+    if (!enabled()) {
+        return;
+    }
+    count = std::min(count, PREFETCH_CARDS);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == wantedCount && std::equal(cards, cards + count, wanted)) {
+        return;
+    }
+    std::copy(cards, cards + count, wanted);
+    wantedCount = count;
+    wake.notify_one();
+}
+
+// Replaces whatever is still playing; called with the lock held
+void PinyinAudio::queue(const Slot& slot, Uint64 requestedAt) {
+    SDL_ClearQueuedAudio(device);
+    SDL_QueueAudio(device, slot.pcm.data(), (Uint32)(slot.pcm.size() * sizeof(int16_t)));
+    latency.addFrame((double)(SDL_GetPerformanceCounter() - requestedAt) * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
+void PinyinAudio::play(CardId card) {
+    if (!enabled()) {
+        return;
+    }
+    Uint64 now = SDL_GetPerformanceCounter();
+    std::lock_guard<std::mutex> lock(mutex);
+    plays++;
+    for (Slot& slot : slots) {
+        if (slot.card == card && slot.ready) {
+            slot.lastUsed = ++useClock;
+            cacheHits++;
+            pendingPlay = NO_CARD;
+            queue(slot, now);
+            return;
+        }
+    }
+    pendingPlay = card;
+    pendingSince = now;
+    wake.notify_one();
+}
+
+void PinyinAudio::run() {
+    AllocScope scope(ALLOC_AUDIO);
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || nextToDecode() != NO_CARD; });
+        if (stopping) {
+            return;
+        }
+        CardId card = nextToDecode();
+        Slot& slot = victim();
+        slot.card = card;
+        slot.ready = false;
+        lock.unlock();
+
+        decodeCard(card, slot.pcm);
+
+        lock.lock();
+        slot.ready = true;
+        slot.lastUsed = ++useClock;
+        if (pendingPlay == card) {
+            pendingPlay = NO_CARD;
+            queue(slot, pendingSince);
+        }
+    }
+}
+
+// Cuts letters [begin, end) of one word into syllables the pack has, preferring the longest
+// first syllable that leaves a rest that can be cut too ("xian" rather than "xi an"). Letters
+// no split covers are skipped.
+void PinyinAudio::splitSyllables(uint32_t begin, uint32_t end) {
+    const std::string& letters = normalized.letters;
+    // longestFrom[i]: the end of the first syllable of a full split of [i, end), or 0 if none
+    longestFrom.assign(end - begin + 1, 0);
+    longestFrom[end - begin] = end;
+    for (uint32_t i = end; i-- > begin;) {
+        for (uint32_t length = std::min(MAX_SYLLABLE_LETTERS, end - i); length > 0; length--) {
+            if (longestFrom[i + length - begin] && pack.hasSyllable(std::string_view(letters).substr(i, length))) {
+                longestFrom[i - begin] = i + length;
+                break;
+            }
+        }
+    }
+    for (uint32_t i = begin; i < end;) {
+        uint32_t next = longestFrom[i - begin];
+        if (!next) {
+            // no full split from here: take the longest syllable there is, or drop a letter
+            for (uint32_t length = std::min(MAX_SYLLABLE_LETTERS, end - i); length > 0 && !next; length--) {
+                if (pack.hasSyllable(std::string_view(letters).substr(i, length))) {
+                    next = i + length;
+                }
+            }
+            if (!next) {
+                i++;
+                continue;
+            }
+        }
+        syllableEnds.push_back(i);
+        syllableEnds.push_back(next);
+        i = next;
+    }
+}
+
+void PinyinAudio::decodeCard(CardId card, std::vector<int16_t>& pcm) {
+    pcm.clear();
+    pinyinText.assign(cardStore.pinyin(card));
+    normalizePinyin(pinyinText, normalized);
+    syllableEnds.clear();
+    uint32_t letterCount = (uint32_t)normalized.letters.size();
+    for (size_t word = 0; word < normalized.wordStarts.size(); word++) {
+        uint32_t end = word + 1 < normalized.wordStarts.size() ? normalized.wordStarts[word + 1] : letterCount;
+        splitSyllables(normalized.wordStarts[word], end);
+    }
+
+    size_t maxSamples = pcm.capacity();
+    size_t gap = (size_t)pack.sampleRate() * GAP_MS / 1000;
+    char name[ClipPack::MAX_NAME];
+    for (size_t i = 0; i < syllableEnds.size(); i += 2) {
+        uint32_t begin = syllableEnds[i];
+        uint32_t end = syllableEnds[i + 1];
+        // the syllable's tone is whichever of its letters carries one; none is neutral
+        char tone = '5';
+        for (uint32_t letter = begin; letter < end; letter++) {
+            if (normalized.tones[letter] != '0') {
+                tone = normalized.tones[letter];
+            }
+        }
+        size_t length = end - begin;
+        memcpy(name, normalized.letters.data() + begin, length);
+        name[length] = tone;
+        int clip = pack.find(std::string_view(name, length + 1));
+        if (clip < 0) {
+            name[length] = '5';
+            clip = pack.find(std::string_view(name, length + 1));
+        }
+        if (clip < 0) {
+            continue;
+        }
+        size_t wanted = (pcm.empty() ? 0 : gap) + pack.sampleCount(clip);
+        if (pcm.size() + wanted > maxSamples) {
+            break;
+        }
+        if (!pcm.empty()) {
+            pcm.resize(pcm.size() + gap, 0);
+        }
+        pack.decode(clip, pcm);
+    }
+}
+
+void PinyinAudio::printSummary() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (plays == 0) {
+        return;
+    }
+    printf("pronunciation: %llu played, %llu from the cache; queued %.3f ms average, %.3f ms worst, then %.1f ms of device buffer\n",
+        (unsigned long long)plays, (unsigned long long)cacheHits, latency.averageMs(), latency.worstMs(), deviceBufferMs);
+}
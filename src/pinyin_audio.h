@@ -0,0 +1,128 @@
+#pragma once
+
+#include "card_store.h"
+#include "frame_stats.h"
+#include "pinyin_index.h"
+#include <SDL2/SDL.h>
+#include <condition_variable>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Recorded syllables, one file mapped read-only: a header, an index sorted by name ("hao3",
+// "lv4", the neutral tone as 5), then each clip as IMA ADPCM, mono, at the pack's rate.
+// ADPCM keeps a full syllable set to a few MB, at a quarter of the size of 16-bit samples.
+class ClipPack {
+public:
+    ~ClipPack();
+
+    bool open(const char* path);
+    bool loaded() const { return mapping != nullptr; }
+    uint32_t sampleRate() const { return rate; }
+
+    // The clip named exactly 'name', or -1
+    int find(std::string_view name) const;
+    // Whether there's a clip for these toneless letters in any tone
+    bool hasSyllable(std::string_view letters) const;
+    uint32_t sampleCount(int clip) const;
+    // Appends the clip's samples
+    void decode(int clip, std::vector<int16_t>& out) const;
+
+    static constexpr size_t MAX_NAME = 8; // letters and tone, NUL-padded
+
+private:
+    friend bool writeClipPack(const char* directory, const char* path, std::string& error);
+
+    typedef struct ClipEntry {
+        char name[MAX_NAME];
+        uint32_t offset;    // from the start of the file
+        uint32_t samples;
+        int16_t predictor;  // the ADPCM state the clip starts from
+        uint8_t stepIndex;
+        uint8_t padding;
+    } ClipEntry;
+
+    const ClipEntry* entries = nullptr;
+    uint32_t clipCount = 0;
+    uint32_t rate = 0;
+    std::vector<std::string_view> syllables;   // toneless, sorted, into the entries' names
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+};
+
+// Writes a pack at 'path' from the WAV files in 'directory' (16-bit PCM, all at one rate),
+// each named for its syllable: hao3.wav, lv4.wav
+bool writeClipPack(const char* directory, const char* path, std::string& error);
+
+// Says each card's pinyin as its syllable clips in a row. A worker thread splits the pinyin
+// into syllables and decodes their clips into a small LRU of PCM buffers, ahead of time for
+// the cards coming up, so playing a card is only a copy into the device queue. A card that
+// wasn't decoded yet is played by the worker the moment it is; the UI thread never decodes.
+class PinyinAudio {
+public:
+    ~PinyinAudio();
+
+    // Maps the pack and opens the audio device at its rate, with a buffer of a few ms;
+    // false, and silent from then on, if either fails
+    bool open(const char* packPath);
+    void close();
+    bool enabled() const { return device != 0; }
+
+    // The cards coming up, most wanted first; any not cached are decoded in that order
+    void prefetch(const CardId* cards, size_t count);
+    void play(CardId card);
+
+    void printSummary() const;
+
+    static constexpr CardId NO_CARD = UINT32_MAX;
+    static constexpr size_t PREFETCH_CARDS = 4;
+    static constexpr size_t CACHE_SLOTS = 8;        // more than PREFETCH_CARDS, so recent cards replay from the cache
+    static constexpr uint32_t MAX_CARD_SECONDS = 8; // longer pinyin is cut off
+    static constexpr uint32_t GAP_MS = 30;          // silence between syllables
+
+private:
+    typedef struct Slot {
+        CardId card = NO_CARD;
+        bool ready = false;     // while false the worker owns pcm
+        uint64_t lastUsed = 0;
+        std::vector<int16_t> pcm;
+    } Slot;
+
+    void run();
+    bool cached(CardId card) const;
+    CardId nextToDecode() const;
+    Slot& victim();
+    void queue(const Slot& slot, Uint64 requestedAt);
+    void decodeCard(CardId card, std::vector<int16_t>& pcm);
+    void splitSyllables(uint32_t begin, uint32_t end);
+
+    ClipPack pack;
+    SDL_AudioDeviceID device = 0;
+    double deviceBufferMs = 0.0;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Slot> slots;
+    CardId wanted[PREFETCH_CARDS];
+    size_t wantedCount = 0;
+    CardId pendingPlay = NO_CARD; // asked for before it was decoded
+    Uint64 pendingSince = 0;
+    uint64_t useClock = 0;
+    FrameStats latency;         // from play() to the samples being queued
+    uint64_t plays = 0;
+    uint64_t cacheHits = 0;
+    bool stopping = false;
+    std::thread worker;
+
+    // the worker's scratch
+    std::string pinyinText;
+    NormalizedPinyin normalized;
+    std::vector<uint32_t> syllableEnds;
+    std::vector<uint32_t> longestFrom;
+};
+
+extern PinyinAudio pinyinAudio;
@@ -0,0 +1,185 @@
+#include "pinyin_index.h"
+#include "parallel_sort.h"
+#include "utf8.h"
+#include <string.h>
+
+PinyinIndex pinyinIndex;
+
+typedef struct ToneMark {
+    uint16_t codepoint;
+    char letter;
+    char tone;
+} ToneMark;
+
+// Precomposed vowels with tone marks, lower and upper case
+static const ToneMark toneMarks[] = {
+    { 0x0101, 'a', '1' }, { 0x00E1, 'a', '2' }, { 0x01CE, 'a', '3' }, { 0x00E0, 'a', '4' },
+    { 0x0113, 'e', '1' }, { 0x00E9, 'e', '2' }, { 0x011B, 'e', '3' }, { 0x00E8, 'e', '4' },
+    { 0x012B, 'i', '1' }, { 0x00ED, 'i', '2' }, { 0x01D0, 'i', '3' }, { 0x00EC, 'i', '4' },
+    { 0x014D, 'o', '1' }, { 0x00F3, 'o', '2' }, { 0x01D2, 'o', '3' }, { 0x00F2, 'o', '4' },
+    { 0x016B, 'u', '1' }, { 0x00FA, 'u', '2' }, { 0x01D4, 'u', '3' }, { 0x00F9, 'u', '4' },
+    { 0x01D6, 'v', '1' }, { 0x01D8, 'v', '2' }, { 0x01DA, 'v', '3' }, { 0x01DC, 'v', '4' },
+    { 0x0100, 'a', '1' }, { 0x00C1, 'a', '2' }, { 0x01CD, 'a', '3' }, { 0x00C0, 'a', '4' },
+    { 0x0112, 'e', '1' }, { 0x00C9, 'e', '2' }, { 0x011A, 'e', '3' }, { 0x00C8, 'e', '4' },
+    { 0x012A, 'i', '1' }, { 0x00CD, 'i', '2' }, { 0x01CF, 'i', '3' }, { 0x00CC, 'i', '4' },
+    { 0x014C, 'o', '1' }, { 0x00D3, 'o', '2' }, { 0x01D1, 'o', '3' }, { 0x00D2, 'o', '4' },
+    { 0x016A, 'u', '1' }, { 0x00DA, 'u', '2' }, { 0x01D3, 'u', '3' }, { 0x00D9, 'u', '4' },
+    { 0x01D5, 'v', '1' }, { 0x01D7, 'v', '2' }, { 0x01D9, 'v', '3' }, { 0x01DB, 'v', '4' },
+    { 0x00FC, 'v', 0 }, { 0x00DC, 'v', 0 }, { 0x00EA, 'e', 0 }, { 0x00CA, 'e', 0 },
+    { 0x0144, 'n', '2' }, { 0x0148, 'n', '3' }, { 0x01F9, 'n', '4' }, { 0x1E3F, 'm', '2' },
+};
+
+void normalizePinyin(const std::string& text, NormalizedPinyin& out) {
+    out.letters.clear();
+    out.tones.clear();
+    out.wordStarts.clear();
+    out.given.clear();
+    bool inWord = false;
+    uint32_t syllableStart = 0; // where a tone digit's syllable begins: the word start or the previous digit
+    size_t openMarks = 0;       // marks in the current word, whose syllable runs to the end of the word
+    auto endWord = [&]() {
+        for (size_t i = openMarks; i < out.given.size(); i++) {
+            out.given[i].end = (uint32_t)out.letters.size();
+        }
+        openMarks = out.given.size();
+        inWord = false;
+    };
+    auto addLetter = [&](char letter) {
+        if (!inWord) {
+            out.wordStarts.push_back((uint32_t)out.letters.size());
+            syllableStart = (uint32_t)out.letters.size();
+            inWord = true;
+        }
+        out.letters += letter;
+        out.tones += '0';
+    };
+    auto addTone = [&](char tone, bool fromDigit) {
+        if (out.letters.empty()) {
+            return;
+        }
+        out.tones.back() = tone;
+        PinyinTone given;
+        given.begin = fromDigit ? syllableStart : (uint32_t)out.letters.size() - 1;
+        given.end = (uint32_t)out.letters.size();
+        given.tone = tone;
+        given.fromDigit = fromDigit;
+        out.given.push_back(given);
+        if (fromDigit) {
+            openMarks = out.given.size();
+            syllableStart = (uint32_t)out.letters.size();
+        }
+    };
+
+    const char* p = text.c_str();
+    const char* end = p + text.size();
+    while (p < end) {
+        uint32_t c;
+        p += decodeUtf8(p, end, &c);
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+        if (c >= 'a' && c <= 'z') {
+            addLetter((char)c);
+        } else if (c >= '1' && c <= '4') {
+            addTone((char)c, true);
+        } else if (c == '5' || c == '0') {
+            syllableStart = (uint32_t)out.letters.size(); // neutral tone, only ends the syllable
+        } else if (c == ':' && !out.letters.empty() && out.letters.back() == 'u') {
+            out.letters.back() = 'v'; // u: for ü
+        } else if (c == 0x0304 || c == 0x0301 || c == 0x030C || c == 0x0300) {
+            // combining tone mark on the previous vowel
+            addTone(c == 0x0304 ? '1' : c == 0x0301 ? '2' : c == 0x030C ? '3' : '4', false);
+        } else if (c == 0x0308 && !out.letters.empty() && out.letters.back() == 'u') {
+            out.letters.back() = 'v'; // combining diaeresis
+        } else {
+            const ToneMark* mark = nullptr;
+            for (const ToneMark& m : toneMarks) {
+                if (m.codepoint == c) {
+                    mark = &m;
+                    break;
+                }
+            }
+            if (mark) {
+                addLetter(mark->letter);
+                if (mark->tone) {
+                    addTone(mark->tone, false);
+                }
+            } else if (inWord) {
+                endWord(); // spaces, apostrophes, punctuation and anything else separate words
+            }
+        }
+    }
+    endWord();
+}
+
+void PinyinIndex::addCard(uint32_t id, const std::string& pinyin) {
+    normalizePinyin(pinyin, normalized);
+    if (normalized.letters.empty()) {
+        return;
+    }
+    uint32_t offset = (uint32_t)letterPool.size();
+    letterPool.append(normalized.letters.c_str(), normalized.letters.size() + 1);
+    tonePool.append(normalized.tones.c_str(), normalized.tones.size() + 1);
+    for (uint32_t start : normalized.wordStarts) {
+        Entry entry;
+        entry.offset = offset + start;
+        entry.card = id;
+        entries.push_back(entry);
+    }
+}
+
+void PinyinIndex::commit() {
+    if (sortedCount == entries.size()) {
+        return;
+    }
+    const char* pool = letterPool.c_str();
+    parallelSort(entries.begin(), entries.end(), [pool](const Entry& a, const Entry& b) {
+        int order = strcmp(pool + a.offset, pool + b.offset);
+        return order != 0 ? order < 0 : a.card < b.card;
+    });
+    sortedCount = entries.size();
+}
+
+// Checks the query's tones against the card text at 'offset'. A tone digit ends its syllable,
+// so it must match the last tone the card has in that range; a marked vowel starts the search,
+// so it must match the first tone from there to the end of the query word. Either way this
+// lines up whether the card marks its vowels or writes digits.
+bool PinyinIndex::tonesMatch(uint32_t offset) const {
+    const char* tones = tonePool.c_str() + offset;
+    for (const PinyinTone& given : normalized.given) {
+        char found = '0';
+        for (uint32_t i = given.begin; i < given.end; i++) {
+            if (tones[i] != '0') {
+                found = tones[i];
+                if (!given.fromDigit) {
+                    break;
+                }
+            }
+        }
+        if (found != given.tone) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PinyinIndex::search(const std::string& query, CardSet& cards) {
+    commit();
+    normalizePinyin(query, normalized);
+    if (normalized.letters.empty()) {
+        return false;
+    }
+    const char* pool = letterPool.c_str();
+    const char* key = normalized.letters.c_str();
+    size_t keyLength = normalized.letters.size();
+
+    auto first = std::lower_bound(entries.begin(), entries.end(), key, [pool](const Entry& entry, const char* k) {
+        return strcmp(pool + entry.offset, k) < 0;
+    });
+    for (auto it = first; it != entries.end() && strncmp(pool + it->offset, key, keyLength) == 0; ++it) {
+        if (normalized.given.empty() || tonesMatch(it->offset)) {
+            cards.insert(it->card);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "postings.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Pinyin split into toneless letters and the tones that go with them: "jīntiān",
+// "jin1tian1" and "JINTIAN" all have the letters "jintian". ü, u: and v are all
+// written v. 'tones' runs parallel to 'letters', holding '1'-'4' on the letter that
+// carried the tone (the marked vowel, or the last letter before a tone digit) and
+// '0' elsewhere, so neutral and unmarked syllables have no tone.
+typedef struct PinyinTone {
+    uint32_t begin;     // letter range of the syllable the tone was given for
+    uint32_t end;
+    char tone;
+    bool fromDigit;     // written after the syllable (jin1) rather than marked on its vowel (jīn)
+} PinyinTone;
+
+typedef struct NormalizedPinyin {
+    std::string letters;
+    std::string tones;
+    std::vector<uint32_t> wordStarts; // after spaces, apostrophes and punctuation
+    std::vector<PinyinTone> given;     // each tone as the text gave it, for matching queries
+} NormalizedPinyin;
+
+void normalizePinyin(const std::string& text, NormalizedPinyin& out);
+
+// Sorted index of the normalized pinyin of every card, keyed from each word start,
+// so "tian" finds "jīntiān" only if written as a separate word ("jīn tiān") but
+// "yuping" finds "lù yùpíng". Cards are normalized once, as they are added.
+class PinyinIndex {
+public:
+    void addCard(uint32_t id, const std::string& pinyin);
+    // Sorts the entries added since the last call; search() does it if needed
+    void commit();
+
+    // Adds to 'cards' every card with a word starting with the query's letters. Tones the
+    // query gives must match the card's tone on the same syllable; syllables given without
+    // a tone match any. Returns false if the query has no letters.
+    bool search(const std::string& query, CardSet& cards);
+
+private:
+    typedef struct Entry {
+        uint32_t offset;    // where the word starts in the pools; each card's text is NUL-terminated
+        uint32_t card;
+    } Entry;
+
+    bool tonesMatch(uint32_t offset) const;
+
+    std::string letterPool;
+    std::string tonePool;   // parallel to letterPool
+    std::vector<Entry> entries;
+    size_t sortedCount = 0;
+    NormalizedPinyin normalized; // scratch, reused between cards and queries
+};
+
+extern PinyinIndex pinyinIndex;
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Ascending card ids stored as varint-encoded gaps from the previous id,
+// 7 bits per byte with the high bit marking a continuation. Dense lists of
+// small gaps take about one byte per card.
+class PostingList {
+public:
+    // Ids must be added in ascending order; repeating the last id is a no-op
+    void add(uint32_t id) {
+        if (count != 0 && id == last) {
+            return;
+        }
+        uint32_t gap = count == 0 ? id : id - last;
+        while (gap >= 0x80) {
+            bytes.push_back((uint8_t)(gap | 0x80));
+            gap >>= 7;
+        }
+        bytes.push_back((uint8_t)gap);
+        last = id;
+        count++;
+    }
+
+    template<typename Fn>
+    void forEach(Fn fn) const {
+        uint32_t id = 0;
+        const uint8_t* p = bytes.data();
+        const uint8_t* end = p + bytes.size();
+        while (p < end) {
+            uint32_t gap = 0;
+            int shift = 0;
+            while (*p & 0x80) {
+                gap |= (uint32_t)(*p++ & 0x7F) << shift;
+                shift += 7;
+            }
+            gap |= (uint32_t)*p++ << shift;
+            id += gap;
+            fn(id);
+        }
+    }
+
+    uint32_t size() const { return count; }
+    size_t byteSize() const { return bytes.size(); }
+
+private:
+    std::vector<uint8_t> bytes;
+    uint32_t last = 0;
+    uint32_t count = 0;
+};
+
+// A set of card ids as one bit per card, for combining posting lists
+class CardSet {
+public:
+    void reset(uint32_t cardCount) {
+        words.assign((cardCount + 63) / 64, 0);
+    }
+    void insert(uint32_t id) {
+        words[id >> 6] |= 1ull << (id & 63);
+    }
+    bool contains(uint32_t id) const {
+        return (words[id >> 6] >> (id & 63)) & 1;
+    }
+    void intersect(const CardSet& other) {
+        for (size_t i = 0; i < words.size(); i++) {
+            words[i] &= other.words[i];
+        }
+    }
+    void unite(const CardSet& other) {
+        for (size_t i = 0; i < words.size(); i++) {
+            words[i] |= other.words[i];
+        }
+    }
+    // Appends the members in ascending order
+    void collect(std::vector<uint32_t>& out) const {
+        for (size_t i = 0; i < words.size(); i++) {
+            for (uint64_t word = words[i]; word; word &= word - 1) {
+                out.push_back((uint32_t)(i * 64 + __builtin_ctzll(word)));
+            }
+        }
+    }
+
+private:
+    std::vector<uint64_t> words;
+};
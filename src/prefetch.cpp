@@ -0,0 +1,108 @@
+#include "prefetch.h"
+#include "alloc_profiler.h"
+#include "text_layout.h"
+#include "utf8.h"
+#include <algorithm>
+
+CardPrefetcher prefetcher;
+
+CardPrefetcher::CardPrefetcher() : worker(&CardPrefetcher::run, this) {}
+
+CardPrefetcher::~CardPrefetcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void CardPrefetcher::makeKey(std::string& key, std::string_view text, ImFont* font, float fontSize, float wrapWidth) {
+    key.assign(text);
+    key.append((const char*)&font, sizeof(font));
+    key.append((const char*)&fontSize, sizeof(fontSize));
+    key.append((const char*)&wrapWidth, sizeof(wrapWidth));
+}
+
+void CardPrefetcher::request(std::string_view text, ImFont* font, float fontSize, float wrapWidth) {
+    if (textLayouts.contains(text, font, fontSize, wrapWidth)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        makeKey(lookupKey, text, font, fontSize, wrapWidth);
+        if (pendingKeys.count(lookupKey)) {
+            return;
+        }
+        jobs.push_back(Job{lookupKey, text.size(), font, fontSize, wrapWidth, true});
+        pendingKeys.insert(jobs.back().key);
+    }
+    wake.notify_one();
+}
+
+void CardPrefetcher::requestGlyphs(std::string text, ImFont* font) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t length = text.size();
+        jobs.push_back(Job{std::move(text), length, font, 0.0f, 0.0f, false});
+    }
+    wake.notify_one();
+}
+
+void CardPrefetcher::waitIdle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return jobs.empty() && !busy; });
+}
+
+bool CardPrefetcher::takeMissingGlyphs(std::vector<ImWchar>& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (missingGlyphs.empty()) {
+        return false;
+    }
+    std::sort(missingGlyphs.begin(), missingGlyphs.end());
+    missingGlyphs.erase(std::unique(missingGlyphs.begin(), missingGlyphs.end()), missingGlyphs.end());
+    out.swap(missingGlyphs);
+    missingGlyphs.clear();
+    return true;
+}
+
+void CardPrefetcher::run() {
+    AllocScope scope(ALLOC_PREFETCH);
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (stopping) {
+            return;
+        }
+        if (jobs.front().layout) {
+            pendingKeys.erase(jobs.front().key);
+        }
+        Job job = std::move(jobs.front());
+        jobs.pop_front();
+        busy = true;
+        lock.unlock();
+
+        std::string_view text(job.key.data(), job.textLength);
+        if (job.layout) {
+            textLayouts.prepare(text, job.font, job.fontSize, job.wrapWidth);
+        }
+
+        std::vector<ImWchar> missing;
+        const char* end = text.data() + text.size();
+        for (const char* s = text.data(); s < end;) {
+            uint32_t codepoint;
+            s += decodeUtf8(s, end, &codepoint);
+            bool printable = codepoint >= 0x20 && codepoint <= IM_UNICODE_CODEPOINT_MAX;
+            if (printable && !job.font->FindGlyphNoFallback((ImWchar)codepoint)) {
+                missing.push_back((ImWchar)codepoint);
+            }
+        }
+
+        lock.lock();
+        missingGlyphs.insert(missingGlyphs.end(), missing.begin(), missing.end());
+        busy = false;
+        if (jobs.empty()) {
+            idle.notify_all();
+        }
+    }
+}
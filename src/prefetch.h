@@ -0,0 +1,56 @@
+#pragma once
+
+#include "imgui.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Resolves upcoming cards on a worker thread while the current one is shown:
+// measures their text into textLayouts and notes code points the font lacks,
+// so switching to the next card finds everything ready
+class CardPrefetcher {
+public:
+    CardPrefetcher();
+    ~CardPrefetcher();
+
+    // Queues text for layout in the given font, unless it is cached or already pending
+    void request(std::string_view text, ImFont* font, float fontSize, float wrapWidth);
+    // Queues text only to be checked for code points the font lacks, with no layout; for
+    // whole sessions at once, which would be too many layouts to queue one by one
+    void requestGlyphs(std::string text, ImFont* font);
+    // Blocks until the worker has nothing left to do, e.g. before rebuilding fonts
+    void waitIdle();
+    // Moves out the code points found missing since the last call
+    bool takeMissingGlyphs(std::vector<ImWchar>& out);
+
+private:
+    typedef struct Job {
+        std::string key;    // the text, then the font, size and width it's laid out with
+        size_t textLength;
+        ImFont* font;
+        float fontSize;
+        float wrapWidth;
+        bool layout;        // false for glyph checks, which have no key beyond the text
+    } Job;
+
+    void run();
+    static void makeKey(std::string& key, std::string_view text, ImFont* font, float fontSize, float wrapWidth);
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::deque<Job> jobs;
+    std::unordered_set<std::string_view> pendingKeys; // into the layout jobs' keys, which stay put in the deque
+    std::string lookupKey;                            // request()'s scratch, so repeated requests don't allocate
+    std::vector<ImWchar> missingGlyphs;
+    bool busy = false;
+    bool stopping = false;
+    std::thread worker;
+};
+
+extern CardPrefetcher prefetcher;
@@ -0,0 +1,93 @@
+#include "replay.h"
+#include <string.h>
+
+static const char replayMagic[4] = {'F', 'C', 'R', 'P'};
+static const uint32_t replayVersion = 1;
+
+typedef struct ReplayHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t eventSize;     // sizeof(SDL_Event) of the recording build
+    uint32_t seed;
+} ReplayHeader;
+
+InputRecorder::~InputRecorder() {
+    if (file) {
+        fclose(file);
+    }
+}
+
+bool InputRecorder::start(const char* path, uint32_t seed) {
+    file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    ReplayHeader header;
+    memcpy(header.magic, replayMagic, sizeof(replayMagic));
+    header.version = replayVersion;
+    header.eventSize = sizeof(SDL_Event);
+    header.seed = seed;
+    fwrite(&header, sizeof(header), 1, file);
+    startTicks = SDL_GetTicks();
+    return true;
+}
+
+void InputRecorder::record(uint32_t frame, const SDL_Event& event) {
+    if (!file) {
+        return;
+    }
+    RecordedEvent recorded;
+    recorded.frame = frame;
+    recorded.ms = SDL_GetTicks() - startTicks;
+    recorded.event = event;
+    fwrite(&recorded, sizeof(recorded), 1, file);
+}
+
+void InputRecorder::stop(uint32_t frame) {
+    if (!file) {
+        return;
+    }
+    SDL_Event quit;
+    memset(&quit, 0, sizeof(quit));
+    quit.type = SDL_QUIT;
+    record(frame, quit);
+    fclose(file);
+    file = nullptr;
+}
+
+bool InputReplay::load(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    ReplayHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1
+        && memcmp(header.magic, replayMagic, sizeof(replayMagic)) == 0
+        && header.version == replayVersion
+        && header.eventSize == sizeof(SDL_Event);
+    if (ok) {
+        recordedSeed = header.seed;
+        RecordedEvent recorded;
+        while (fread(&recorded, sizeof(recorded), 1, file) == 1) {
+            events.push_back(recorded);
+        }
+    }
+    fclose(file);
+    cursor = 0;
+    startTicks = SDL_GetTicks();
+    return ok;
+}
+
+bool InputReplay::next(uint32_t frame, SDL_Event* event) {
+    if (finished()) {
+        return false;
+    }
+    const RecordedEvent& recorded = events[cursor];
+    bool due = realtime ? SDL_GetTicks() - startTicks >= recorded.ms : recorded.frame <= frame;
+    if (!due) {
+        return false;
+    }
+    *event = recorded.event;
+    cursor++;
+    return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+// Recording of everything fed to ImGui_ImplSDL2_ProcessEvent, plus the seed
+// used for shuffling, so that a session can be played back exactly
+
+typedef struct RecordedEvent {
+    uint32_t frame;     // frame the event was processed on
+    uint32_t ms;        // milliseconds since recording started
+    SDL_Event event;
+} RecordedEvent;
+
+class InputRecorder {
+public:
+    ~InputRecorder();
+
+    bool start(const char* path, uint32_t seed);
+    void record(uint32_t frame, const SDL_Event& event);
+    // Appends a final SDL_QUIT so a replay ends on the same frame
+    void stop(uint32_t frame);
+    bool active() const { return file != nullptr; }
+
+private:
+    FILE* file = nullptr;
+    uint32_t startTicks = 0;
+};
+
+class InputReplay {
+public:
+    bool load(const char* path);
+    uint32_t seed() const { return recordedSeed; }
+
+    // Max speed: events are delivered on the frame they were recorded on.
+    // Real time: events are delivered once their timestamp has passed.
+    void setRealtime(bool enabled) { realtime = enabled; }
+    bool isRealtime() const { return realtime; }
+
+    // Returns the next event due on this frame, if any
+    bool next(uint32_t frame, SDL_Event* event);
+    bool finished() const { return cursor >= events.size(); }
+
+private:
+    std::vector<RecordedEvent> events;
+    size_t cursor = 0;
+    uint32_t recordedSeed = 0;
+    bool realtime = false;
+    uint32_t startTicks = 0;
+};
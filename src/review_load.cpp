@@ -0,0 +1,136 @@
+#include "review_load.h"
+#include "review_server.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+typedef struct LoadResult {
+    bool failed = false;
+    uint64_t grades = 0;        // answered with REVIEW_OK
+    uint64_t batches = 0;
+    double totalMs = 0.0;       // batch round trips
+    double worstMs = 0.0;
+} LoadResult;
+
+static ReviewRequest loadRequest(ReviewOp op, uint32_t tag, uint32_t card, uint32_t arg) {
+    ReviewRequest request = {};
+    request.op = (uint8_t)op;
+    request.tag = tag;
+    request.card = card;
+    request.arg = arg;
+    return request;
+}
+
+// Sends 'requests' (payloads, if any, already in 'bytes') in one write and reads every reply,
+// counting the grades that went through. Sets 'restart' if the session ran out.
+static bool exchange(int fd, const std::vector<char>& bytes, size_t count, std::vector<char>& payload, LoadResult& result, bool& restart) {
+    if (!writeAll(fd, bytes.data(), bytes.size())) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        ReviewReply reply;
+        if (!readAll(fd, &reply, sizeof(reply))) {
+            return false;
+        }
+        payload.resize(reply.length);
+        if (reply.length && !readAll(fd, payload.data(), reply.length)) {
+            return false;
+        }
+        if (reply.op == REVIEW_GRADE && reply.status == REVIEW_OK) {
+            result.grades++;
+        }
+        if ((reply.op == REVIEW_GRADE || reply.op == REVIEW_START) && (reply.status == REVIEW_EMPTY || reply.card == ANY_CARD)) {
+            restart = true;
+        }
+    }
+    return true;
+}
+
+static void loadClient(const char* address, int index, int batch, Clock::time_point until, LoadResult& result) {
+    int fd = connectReviewServer(address);
+    if (fd < 0) {
+        result.failed = true;
+        return;
+    }
+    std::vector<char> bytes;
+    std::vector<char> payload;
+    auto append = [&bytes](const ReviewRequest& request, const void* data) {
+        bytes.insert(bytes.end(), (const char*)&request, (const char*)&request + sizeof(request));
+        bytes.insert(bytes.end(), (const char*)data, (const char*)data + request.length);
+    };
+
+    std::string name = "load-" + std::to_string(index + 1);
+    ReviewRequest open = loadRequest(REVIEW_OPEN, 0, ANY_CARD, 0);
+    open.length = (uint16_t)name.size();
+    append(open, name.data());
+    append(loadRequest(REVIEW_START, 0, ANY_CARD, ALL_LESSONS), nullptr);
+    bool restart = false;
+    if (!exchange(fd, bytes, 2, payload, result, restart)) {
+        result.failed = true;
+        close(fd);
+        return;
+    }
+
+    std::minstd_rand rng(index + 1);
+    while (Clock::now() < until) {
+        bytes.clear();
+        size_t count = 0;
+        if (restart) {
+            append(loadRequest(REVIEW_START, count++, ANY_CARD, ALL_LESSONS), nullptr);
+            restart = false;
+        }
+        for (int i = 0; i < batch; i++) {
+            append(loadRequest(REVIEW_GRADE, count++, ANY_CARD, rng() % 5 != 0), nullptr);
+        }
+        Clock::time_point sent = Clock::now();
+        if (!exchange(fd, bytes, count, payload, result, restart)) {
+            result.failed = true;
+            break;
+        }
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - sent).count();
+        result.batches++;
+        result.totalMs += ms;
+        if (ms > result.worstMs) {
+            result.worstMs = ms;
+        }
+    }
+    close(fd);
+}
+
+int runReviewLoad(const char* address, int clients, int batch, double seconds) {
+    std::vector<LoadResult> results(clients);
+    std::vector<std::thread> threads;
+    Clock::time_point start = Clock::now();
+    Clock::time_point until = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    for (int i = 0; i < clients; i++) {
+        threads.emplace_back(loadClient, address, i, batch, until, std::ref(results[i]));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    LoadResult total;
+    for (const LoadResult& result : results) {
+        total.failed |= result.failed;
+        total.grades += result.grades;
+        total.batches += result.batches;
+        total.totalMs += result.totalMs;
+        total.worstMs = std::max(total.worstMs, result.worstMs);
+    }
+    if (total.failed) {
+        printf("Error: lost the connection to %s\n", address);
+    }
+    printf("%d clients, batches of %d: %.0f grades/s (%llu in %.2f s), %.3f ms average round trip, %.3f ms worst\n",
+        clients, batch, total.grades / elapsed, (unsigned long long)total.grades, elapsed,
+        total.batches ? total.totalMs / total.batches : 0.0, total.worstMs);
+    return total.failed ? 1 : 0;
+}
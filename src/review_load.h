@@ -0,0 +1,8 @@
+#pragma once
+
+// --load-test: drives a --serve server from 'clients' connections, a thread each. Every
+// connection opens its own profile ("load-1", ...), starts a session over every card and
+// then grades whatever card is in front, 'batch' requests at a time and four in five as
+// known, starting a new session whenever one runs out. Prints the grades handled per second
+// and the round trip per batch; returns nonzero if the server couldn't be reached.
+int runReviewLoad(const char* address, int clients, int batch, double seconds);
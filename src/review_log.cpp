@@ -0,0 +1,319 @@
+#include "review_log.h"
+#include <algorithm>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char reviewLogMagic[4] = { 'F', 'C', 'R', 'L' };
+static const uint32_t reviewLogVersion = 1;
+
+typedef struct ReviewLogHeader {
+    char magic[4];
+    uint32_t version;
+} ReviewLogHeader;
+
+ReviewLog::~ReviewLog() {
+    if (file) {
+        fclose(file);
+    }
+}
+
+bool ReviewLog::open(const char* path, uint64_t installId) {
+    origin = installId;
+    if (!path) {
+        entries.reserve(RESERVED_ENTRIES);
+        return true;
+    }
+    ReviewLogHeader header;
+    FILE* existing = fopen(path, "rb");
+    bool valid = false;
+    if (existing) {
+        fseek(existing, 0, SEEK_END);
+        long size = ftell(existing);
+        fseek(existing, 0, SEEK_SET);
+        valid = size >= (long)sizeof(header) && fread(&header, sizeof(header), 1, existing) == 1
+            && memcmp(header.magic, reviewLogMagic, sizeof(reviewLogMagic)) == 0
+            && header.version == reviewLogVersion;
+        if (valid) {
+            // a record cut short by a crash is dropped, so appends stay aligned
+            size_t count = (size - sizeof(header)) / sizeof(ReviewEntry);
+            std::vector<ReviewEntry> stored(count);
+            valid = fread(stored.data(), sizeof(ReviewEntry), count, existing) == count;
+            for (const ReviewEntry& entry : stored) {
+                append(entry);
+            }
+            if (valid && (size - sizeof(header)) % sizeof(ReviewEntry) != 0) {
+                valid = truncate(path, sizeof(header) + count * sizeof(ReviewEntry)) == 0;
+            }
+        }
+        fclose(existing);
+    }
+    entries.reserve(entries.size() + RESERVED_ENTRIES);
+    if (!valid) {
+        entries.clear();
+        clockList.clear();
+        file = fopen(path, "wb");
+        if (!file) {
+            return false;
+        }
+        setvbuf(file, fileBuffer, _IOFBF, sizeof(fileBuffer));
+        memcpy(header.magic, reviewLogMagic, sizeof(reviewLogMagic));
+        header.version = reviewLogVersion;
+        return fwrite(&header, sizeof(header), 1, file) == 1 && fflush(file) == 0;
+    }
+    file = fopen(path, "ab");
+    if (file) {
+        setvbuf(file, fileBuffer, _IOFBF, sizeof(fileBuffer));
+    }
+    return file != nullptr;
+}
+
+uint32_t ReviewLog::seqFrom(uint64_t from) const {
+    for (const LogClock& clock : clockList) {
+        if (clock.origin == from) {
+            return clock.seq;
+        }
+    }
+    return 0;
+}
+
+void ReviewLog::append(const ReviewEntry& entry) {
+    entries.push_back(entry);
+    for (LogClock& clock : clockList) {
+        if (clock.origin == entry.origin) {
+            clock.seq = std::max(clock.seq, entry.seq);
+            return;
+        }
+    }
+    clockList.push_back(LogClock{ entry.origin, entry.seq });
+}
+
+const ReviewEntry& ReviewLog::add(CardId card, ReviewLogKind kind, uint32_t day) {
+    ReviewEntry entry = {};
+    entry.origin = origin;
+    entry.seq = seqFrom(origin) + 1;
+    entry.time = (uint32_t)::time(nullptr);
+    entry.day = day;
+    entry.card = card;
+    entry.kind = (uint8_t)kind;
+    append(entry);
+    if (file) {
+        fwrite(&entry, sizeof(entry), 1, file);
+    }
+    return entries.back();
+}
+
+void ReviewLog::flush() {
+    if (file) {
+        fflush(file);
+    }
+}
+
+void ReviewLog::replay(CardSchedule& schedule) const {
+    schedule.reset(schedule.size());
+    replayRange(schedule, std::vector<char>());
+}
+
+void ReviewLog::replay(CardSchedule& schedule, const std::vector<CardId>& cards) const {
+    std::vector<char> wanted(schedule.size(), 0);
+    for (CardId card : cards) {
+        schedule.resetCard(card);
+        wanted[card] = 1;
+    }
+    replayRange(schedule, wanted);
+}
+
+// Per card: each origin's undos cancel that origin's latest answer still standing, then what
+// is left is applied in order of time, origin and seq. 'wanted' empty means every card.
+void ReviewLog::replayRange(CardSchedule& schedule, const std::vector<char>& wanted) const {
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < entries.size(); i++) {
+        CardId card = entries[i].card;
+        if (card < schedule.size() && (wanted.empty() || wanted[card])) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        const ReviewEntry& x = entries[a];
+        const ReviewEntry& y = entries[b];
+        if (x.card != y.card) return x.card < y.card;
+        if (x.origin != y.origin) return x.origin < y.origin;
+        return x.seq < y.seq;
+    });
+
+    std::vector<uint32_t> standing;
+    for (size_t first = 0; first < order.size();) {
+        CardId card = entries[order[first]].card;
+        standing.clear();
+        size_t originStart = 0;
+        size_t last = first;
+        for (; last < order.size() && entries[order[last]].card == card; last++) {
+            const ReviewEntry& entry = entries[order[last]];
+            if (last == first || entry.origin != entries[order[last - 1]].origin) {
+                originStart = standing.size();
+            }
+            if (entry.kind != LOG_UNDO) {
+                standing.push_back(order[last]);
+            } else if (standing.size() > originStart) {
+                standing.pop_back();
+            }
+        }
+        std::sort(standing.begin(), standing.end(), [this](uint32_t a, uint32_t b) {
+            const ReviewEntry& x = entries[a];
+            const ReviewEntry& y = entries[b];
+            if (x.time != y.time) return x.time < y.time;
+            if (x.origin != y.origin) return x.origin < y.origin;
+            return x.seq < y.seq;
+        });
+        for (uint32_t i : standing) {
+            schedule.review(card, entries[i].kind == LOG_CORRECT, entries[i].day);
+        }
+        first = last;
+    }
+}
+
+static void putVarint(std::vector<char>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+static bool getVarint(const char*& data, const char* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && data < end; shift += 7) {
+        uint8_t byte = (uint8_t)*data++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Signed differences, small either way round, as small unsigned numbers
+static uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+void ReviewLog::encodeClocks(const std::vector<LogClock>& clocks, std::vector<char>& out) {
+    putVarint(out, clocks.size());
+    for (const LogClock& clock : clocks) {
+        out.insert(out.end(), (const char*)&clock.origin, (const char*)&clock.origin + sizeof(clock.origin));
+        putVarint(out, clock.seq);
+    }
+}
+
+bool ReviewLog::decodeClocks(const char*& data, const char* end, std::vector<LogClock>& clocks) {
+    uint64_t count;
+    if (!getVarint(data, end, count) || count > (uint64_t)(end - data)) {
+        return false;
+    }
+    clocks.resize(count);
+    for (LogClock& clock : clocks) {
+        uint64_t seq;
+        if (end - data < (ptrdiff_t)sizeof(clock.origin)) {
+            return false;
+        }
+        memcpy(&clock.origin, data, sizeof(clock.origin));
+        data += sizeof(clock.origin);
+        if (!getVarint(data, end, seq)) {
+            return false;
+        }
+        clock.seq = (uint32_t)seq;
+    }
+    return true;
+}
+
+// A group is the origin, the first seq and the count, then per entry the card and kind, and
+// the time and day as differences from the entry before
+std::vector<size_t> ReviewLog::encodeSince(const std::vector<LogClock>& peer, std::vector<char>& out) const {
+    std::vector<size_t> groupEnds;
+    for (const LogClock& clock : clockList) {
+        uint32_t peerSeq = 0;
+        for (const LogClock& theirs : peer) {
+            if (theirs.origin == clock.origin) {
+                peerSeq = theirs.seq;
+            }
+        }
+        if (clock.seq <= peerSeq) {
+            continue;
+        }
+        // an origin's entries are added in seq order, so these come out in order too
+        size_t next = 0;
+        for (uint32_t first = peerSeq + 1; first <= clock.seq; first += MAX_GROUP_ENTRIES) {
+            uint32_t count = std::min<uint32_t>(MAX_GROUP_ENTRIES, clock.seq - first + 1);
+            out.insert(out.end(), (const char*)&clock.origin, (const char*)&clock.origin + sizeof(clock.origin));
+            putVarint(out, first);
+            putVarint(out, count);
+            uint32_t time = 0;
+            uint32_t day = 0;
+            for (uint32_t written = 0; written < count; next++) {
+                const ReviewEntry& entry = entries[next];
+                if (entry.origin != clock.origin || entry.seq < first) {
+                    continue;
+                }
+                putVarint(out, (uint64_t)entry.card << 2 | entry.kind);
+                putVarint(out, zigzag((int64_t)entry.time - time));
+                putVarint(out, zigzag((int64_t)entry.day - day));
+                time = entry.time;
+                day = entry.day;
+                written++;
+            }
+            groupEnds.push_back(out.size());
+        }
+    }
+    return groupEnds;
+}
+
+bool ReviewLog::merge(const char* data, size_t size, std::vector<CardId>& touched, uint32_t cardLimit, size_t& merged) {
+    merged = 0;
+    const char* end = data + size;
+    while (data < end) {
+        uint64_t from, first, count;
+        if (end - data < (ptrdiff_t)sizeof(from)) {
+            return false;
+        }
+        memcpy(&from, data, sizeof(from));
+        data += sizeof(from);
+        if (!getVarint(data, end, first) || !getVarint(data, end, count) || count > MAX_GROUP_ENTRIES) {
+            return false;
+        }
+        uint32_t time = 0;
+        uint32_t day = 0;
+        for (uint64_t i = 0; i < count; i++) {
+            uint64_t cardKind, timeDelta, dayDelta;
+            if (!getVarint(data, end, cardKind) || !getVarint(data, end, timeDelta) || !getVarint(data, end, dayDelta)) {
+                return false;
+            }
+            time = (uint32_t)(time + unzigzag(timeDelta));
+            day = (uint32_t)(day + unzigzag(dayDelta));
+            ReviewEntry entry = {};
+            entry.origin = from;
+            entry.seq = (uint32_t)(first + i);
+            entry.time = time;
+            entry.day = day;
+            entry.card = (CardId)(cardKind >> 2);
+            entry.kind = (uint8_t)(cardKind & 3);
+            if ((cardKind >> 2) >= cardLimit || entry.kind > LOG_UNDO) {
+                return false;
+            }
+            // only the next seq from an origin is taken, so a clock always covers a whole prefix
+            if (entry.seq != seqFrom(from) + 1) {
+                continue;
+            }
+            append(entry);
+            if (file) {
+                fwrite(&entry, sizeof(entry), 1, file);
+            }
+            touched.push_back(entry.card);
+            merged++;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "card_schedule.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+typedef enum ReviewLogKind {
+    LOG_CORRECT,
+    LOG_INCORRECT,
+    LOG_UNDO        // takes back the latest answer to the card from the same origin
+} ReviewLogKind;
+
+// One change to a profile's schedule. Entries are numbered 1, 2, ... by the install that made
+// them, so (origin, seq) names an entry everywhere it is copied to.
+typedef struct ReviewEntry {
+    uint64_t origin;    // install id
+    uint32_t seq;
+    uint32_t time;      // seconds since 1970
+    uint32_t day;       // the review day it was scheduled from
+    CardId card;
+    uint8_t kind;       // ReviewLogKind
+    uint8_t padding[7];
+} ReviewEntry;
+
+// The newest entry held from one origin; every earlier one from it is held too
+typedef struct LogClock {
+    uint64_t origin;
+    uint32_t seq;
+} LogClock;
+
+// A profile's answers from every install it has synced with, appended to a file as they are
+// made or arrive. The schedule is a function of the log alone: each card's surviving answers
+// are replayed in order of time, then origin, then seq, so two installs holding the same
+// entries agree on every card however the entries reached them.
+//
+// Syncing exchanges clocks, then only the entries the other side's clock doesn't cover. On
+// the wire entries are grouped by origin, with consecutive seqs implied and times, days and
+// cards as varints, about 4 bytes an entry.
+class ReviewLog {
+public:
+    ~ReviewLog();
+
+    // Reads 'path' and keeps appending to it; without a path the log is only kept in memory
+    bool open(const char* path, uint64_t origin);
+    // Appends an entry made here and returns it
+    const ReviewEntry& add(CardId card, ReviewLogKind kind, uint32_t day);
+    // Writes out what add() and merge() have buffered
+    void flush();
+
+    size_t size() const { return entries.size(); }
+    const std::vector<LogClock>& clocks() const { return clockList; }
+    uint32_t seqFrom(uint64_t origin) const;
+
+    // Sets every card from the log, or just 'cards'
+    void replay(CardSchedule& schedule) const;
+    void replay(CardSchedule& schedule, const std::vector<CardId>& cards) const;
+
+    // The wire format. encodeSince() appends groups of the entries 'peer' lacks, each small
+    // enough for one request, and returns where each group ends.
+    static void encodeClocks(const std::vector<LogClock>& clocks, std::vector<char>& out);
+    static bool decodeClocks(const char*& data, const char* end, std::vector<LogClock>& clocks);
+    std::vector<size_t> encodeSince(const std::vector<LogClock>& peer, std::vector<char>& out) const;
+    // Adds the entries in 'data' that follow on from what is held, skipping any already held;
+    // the cards they touch are appended to 'touched', once per entry, and 'merged' counts the
+    // entries added. Returns false if 'data' is malformed.
+    bool merge(const char* data, size_t size, std::vector<CardId>& touched, uint32_t cardLimit, size_t& merged);
+
+    static const size_t MAX_GROUP_ENTRIES = 4096; // keeps a group under 64 KB
+    static const size_t RESERVED_ENTRIES = 4096;  // room for a long day's answers before add() allocates
+
+private:
+    void append(const ReviewEntry& entry);
+    void replayRange(CardSchedule& schedule, const std::vector<char>& wanted) const;
+
+    std::vector<ReviewEntry> entries;   // in the order they were added here
+    std::vector<LogClock> clockList;
+    uint64_t origin = 0;
+    FILE* file = nullptr;
+    char fileBuffer[BUFSIZ];
+};
@@ -0,0 +1,285 @@
+#include "review_server.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Read in pieces of this size; a batch of requests is usually one piece
+static const size_t READ_CHUNK = 64 * 1024;
+static const int MAX_EVENTS = 64;
+
+void ReviewConnection::reply(const ReviewRequest& request, ReviewStatus status, uint32_t card, const void* payload, uint32_t length) {
+    ReviewReply header = {};
+    header.op = request.op;
+    header.status = (uint8_t)status;
+    header.tag = request.tag;
+    header.card = card;
+    header.length = length;
+    const char* bytes = (const char*)&header;
+    out.insert(out.end(), bytes, bytes + sizeof(header));
+    if (length) {
+        out.insert(out.end(), (const char*)payload, (const char*)payload + length);
+    }
+}
+
+// A number is a TCP port on the loopback interface, anything else a Unix socket path
+static int reviewSocket(const char* address, sockaddr_storage& storage, socklen_t& size) {
+    memset(&storage, 0, sizeof(storage));
+    char* end;
+    long port = strtol(address, &end, 10);
+    if (*address && *end == '\0' && port > 0 && port < 65536) {
+        sockaddr_in* inet = (sockaddr_in*)&storage;
+        inet->sin_family = AF_INET;
+        inet->sin_port = htons((uint16_t)port);
+        inet->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        size = sizeof(*inet);
+        return socket(AF_INET, SOCK_STREAM, 0);
+    }
+    sockaddr_un* local = (sockaddr_un*)&storage;
+    if (strlen(address) >= sizeof(local->sun_path)) {
+        return -1;
+    }
+    local->sun_family = AF_UNIX;
+    strcpy(local->sun_path, address);
+    size = sizeof(*local);
+    return socket(AF_UNIX, SOCK_STREAM, 0);
+}
+
+// Replies go out as soon as a batch is handled, not held back to fill a segment
+static void setNoDelay(int fd) {
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+int connectReviewServer(const char* address) {
+    sockaddr_storage storage;
+    socklen_t size;
+    int fd = reviewSocket(address, storage, size);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (sockaddr*)&storage, size) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    if (storage.ss_family == AF_INET) {
+        setNoDelay(fd);
+    }
+    return fd;
+}
+
+bool writeAll(int fd, const void* data, size_t size) {
+    const char* bytes = (const char*)data;
+    while (size > 0) {
+        ssize_t sent = write(fd, bytes, size);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        bytes += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+bool readAll(int fd, void* data, size_t size) {
+    char* bytes = (char*)data;
+    while (size > 0) {
+        ssize_t got = ::read(fd, bytes, size);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        bytes += got;
+        size -= got;
+    }
+    return true;
+}
+
+ReviewServer::~ReviewServer() {
+    for (ReviewConnection& connection : connections) {
+        if (connection.fd >= 0) {
+            ::close(connection.fd);
+        }
+    }
+    if (listenFd >= 0) {
+        ::close(listenFd);
+    }
+    if (epollFd >= 0) {
+        ::close(epollFd);
+    }
+    if (!socketPath.empty()) {
+        unlink(socketPath.c_str());
+    }
+}
+
+bool ReviewServer::listen(const char* address) {
+    sockaddr_storage storage;
+    socklen_t size;
+    listenFd = reviewSocket(address, storage, size);
+    if (listenFd < 0) {
+        return false;
+    }
+    if (storage.ss_family == AF_UNIX) {
+        unlink(address); // left behind by a server that didn't exit cleanly
+        socketPath = address;
+    } else {
+        int on = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+    if (bind(listenFd, (sockaddr*)&storage, size) != 0 || ::listen(listenFd, SOMAXCONN) != 0) {
+        return false;
+    }
+    fcntl(listenFd, F_SETFL, O_NONBLOCK);
+    epollFd = epoll_create1(0);
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = listenFd;
+    return epollFd >= 0 && epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) == 0;
+}
+
+void ReviewServer::run(ReviewHandler handler, ReviewBatchDone batchDone) {
+    epoll_event events[MAX_EVENTS];
+    while (!stopping) {
+        int count = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                accept();
+                continue;
+            }
+            ReviewConnection& connection = connections[fd];
+            if (events[i].events & EPOLLOUT) {
+                if (!flush(connection)) {
+                    close(connection);
+                    continue;
+                }
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                read(connection, handler);
+            }
+        }
+        batchDone();
+    }
+}
+
+void ReviewServer::accept() {
+    while (true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK);
+        if (fd < 0) {
+            return;
+        }
+        if (socketPath.empty()) {
+            setNoDelay(fd);
+        }
+        if ((size_t)fd >= connections.size()) {
+            connections.resize(fd + 1);
+        }
+        ReviewConnection& connection = connections[fd];
+        connection.fd = fd;
+        connection.user = nullptr;
+        connection.in.clear();
+        connection.out.clear();
+        connection.outSent = 0;
+        connection.writeBlocked = false;
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+// Takes everything the client has sent, handles every complete request in it and writes the
+// replies back; a request cut off by the end of the read waits for the rest
+void ReviewServer::read(ReviewConnection& connection, ReviewHandler handler) {
+    bool open = true;
+    readBuffer.resize(READ_CHUNK);
+    while (true) {
+        ssize_t got = ::read(connection.fd, readBuffer.data(), READ_CHUNK);
+        if (got == 0 || (got < 0 && errno != EAGAIN && errno != EINTR)) {
+            open = false;
+            break;
+        }
+        if (got > 0) {
+            connection.in.insert(connection.in.end(), readBuffer.data(), readBuffer.data() + got);
+        }
+        if (got < (ssize_t)READ_CHUNK) {
+            break;
+        }
+    }
+
+    size_t used = 0;
+    while (connection.in.size() - used >= sizeof(ReviewRequest)) {
+        ReviewRequest request;
+        memcpy(&request, connection.in.data() + used, sizeof(request));
+        if (connection.in.size() - used - sizeof(request) < request.length) {
+            break;
+        }
+        handler(connection, request, connection.in.data() + used + sizeof(request));
+        used += sizeof(request) + request.length;
+        handled++;
+    }
+    connection.in.erase(connection.in.begin(), connection.in.begin() + used);
+
+    if (!flush(connection) || !open) {
+        close(connection);
+    }
+}
+
+// Writes what it can; if the socket is full, waits for it to drain before reading more
+bool ReviewServer::flush(ReviewConnection& connection) {
+    while (connection.outSent < connection.out.size()) {
+        ssize_t sent = write(connection.fd, connection.out.data() + connection.outSent, connection.out.size() - connection.outSent);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN) {
+                return false;
+            }
+            if (!connection.writeBlocked) {
+                connection.writeBlocked = true;
+                epoll_event event = {};
+                event.events = EPOLLOUT;
+                event.data.fd = connection.fd;
+                epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+            }
+            return true;
+        }
+        connection.outSent += sent;
+    }
+    connection.out.clear();
+    connection.outSent = 0;
+    if (connection.writeBlocked) {
+        connection.writeBlocked = false;
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = connection.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+    }
+    return true;
+}
+
+void ReviewServer::close(ReviewConnection& connection) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, connection.fd, nullptr);
+    ::close(connection.fd);
+    connection.fd = -1;
+    connection.user = nullptr;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Wire format of --serve. Clients are on the same machine, so everything is in the host's
+// byte order. A client may write any number of requests back to back without waiting; each
+// is answered in order with one reply carrying the same tag.
+
+typedef enum ReviewOp {
+    REVIEW_OPEN,    // payload is a profile name: later requests on the connection are for it
+    REVIEW_START,   // new session over lesson 'arg', or every card for ALL_LESSONS; reply card is the front one
+    REVIEW_NEXT,    // reply card is the front one, with its text if REVIEW_WANT_TEXT is set
+    REVIEW_GRADE,   // 'card' (or ANY_CARD, whichever is in front) was known if 'arg' != 0; reply card is the next one
+    REVIEW_STATS,   // reply payload is the profile's CardStats over the whole library
+    REVIEW_SYNC,    // payload is the client's review log clocks; reply payload is the server's, then the entries the client lacks
+    REVIEW_PUSH     // payload is review log groups for the server to merge; reply card is how many were new
+} ReviewOp;
+
+typedef enum ReviewStatus {
+    REVIEW_OK,
+    REVIEW_NO_PROFILE,  // nothing has been opened on this connection
+    REVIEW_EMPTY,       // no session, or every card of it is done
+    REVIEW_STALE,       // the graded card isn't the one in front; reply card is
+    REVIEW_BAD_REQUEST
+} ReviewStatus;
+
+static const uint8_t REVIEW_WANT_TEXT = 1;  // NEXT: payload is english, pinyin and chinese, each ended by '\0'
+static const uint8_t REVIEW_WEIGHTED = 2;   // START: draw each next card by difficulty
+static const uint32_t ANY_CARD = UINT32_MAX;
+static const uint32_t ALL_LESSONS = UINT32_MAX;
+
+typedef struct ReviewRequest {
+    uint8_t op;         // ReviewOp
+    uint8_t flags;
+    uint16_t length;    // payload bytes that follow
+    uint32_t tag;       // copied to the reply, for the client's own use
+    uint32_t card;
+    uint32_t arg;
+} ReviewRequest;
+
+typedef struct ReviewReply {
+    uint8_t op;
+    uint8_t status;     // ReviewStatus
+    uint16_t reserved;
+    uint32_t tag;
+    uint32_t card;      // ANY_CARD when there is none
+    uint32_t length;    // payload bytes that follow
+} ReviewReply;
+
+// One client: what it has sent that isn't handled yet and what is waiting to go back
+typedef struct ReviewConnection {
+    int fd = -1;
+    void* user = nullptr;       // the handler's, e.g. the profile that was opened
+    std::vector<char> in;
+    std::vector<char> out;
+    size_t outSent = 0;
+    bool writeBlocked = false;  // waiting for the socket to take more before reading again
+
+    void reply(const ReviewRequest& request, ReviewStatus status, uint32_t card, const void* payload = nullptr, uint32_t length = 0);
+} ReviewConnection;
+
+// Called for every request, in order; it answers through connection.reply()
+typedef void (*ReviewHandler)(ReviewConnection& connection, const ReviewRequest& request, const char* payload);
+// Called once per wakeup, after every request that arrived with it is handled
+typedef void (*ReviewBatchDone)();
+
+// A single-threaded epoll loop over any number of connections. Every request that has arrived
+// on a connection is handled in one go and the replies written back in one call, so clients
+// that batch their requests pay for one wakeup and one write per batch rather than per request.
+// A client that stops reading isn't read from until its replies drain.
+class ReviewServer {
+public:
+    ~ReviewServer();
+
+    // 'address' is a port on 127.0.0.1 if it's a number, otherwise a Unix socket path
+    bool listen(const char* address);
+    void run(ReviewHandler handler, ReviewBatchDone batchDone);
+    // Makes run() return; safe to call from a signal handler
+    void stop() { stopping = true; }
+    uint64_t requestsHandled() const { return handled; }
+
+private:
+    void accept();
+    void read(ReviewConnection& connection, ReviewHandler handler);
+    bool flush(ReviewConnection& connection);
+    void close(ReviewConnection& connection);
+
+    int listenFd = -1;
+    int epollFd = -1;
+    std::string socketPath;     // removed again on exit
+    std::vector<ReviewConnection> connections; // by fd
+    std::vector<char> readBuffer;
+    std::atomic<bool> stopping{false};
+    uint64_t handled = 0;
+};
+
+// A blocking connection to 'address', as for listen(); -1 if it couldn't be made
+int connectReviewServer(const char* address);
+// Blocking transfers on such a connection; false once it fails or closes
+bool writeAll(int fd, const void* data, size_t size);
+bool readAll(int fd, void* data, size_t size);
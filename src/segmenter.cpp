@@ -0,0 +1,131 @@
+#include "segmenter.h"
+#include "parallel_sort.h"
+#include "utf8.h"
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+static const size_t BLOCK_SIZE = 16 << 20;
+
+// Where a chunk starting near 'position' may begin without cutting a word: just past the
+// next ASCII byte, which always ends a run of hanzi, or failing that at a character start
+static size_t chunkBoundary(const char* text, size_t length, size_t position) {
+    if (position == 0 || position >= length) {
+        return position >= length ? length : 0;
+    }
+    for (size_t i = position; i < length && i < position + 4096; i++) {
+        if ((unsigned char)text[i] < 0x80) {
+            return i + 1;
+        }
+    }
+    while (position < length && ((unsigned char)text[position] & 0xC0) == 0x80) {
+        position++;
+    }
+    return position;
+}
+
+void Segmenter::countRun(const char* run, size_t length, RunScratch& scratch, std::vector<uint64_t>& out) const {
+    scratch.cost.resize(length + 1);
+    scratch.take.resize(length + 1);
+    scratch.word.resize(length + 1);
+    scratch.cost[length] = 0;
+    for (size_t i = length; i-- > 0;) {
+        if (((unsigned char)run[i] & 0xC0) == 0x80) {
+            continue; // inside a character
+        }
+        uint32_t c;
+        size_t charLength = decodeUtf8(run + i, run + length, &c);
+        scratch.cost[i] = scratch.cost[i + charLength] + 1;
+        scratch.take[i] = (uint32_t)charLength;
+        scratch.word[i] = UINT32_MAX;
+        dictionary.forEachPrefix(run + i, length - i, [&](size_t wordLength, uint32_t word) {
+            uint32_t cost = scratch.cost[i + wordLength] + 1;
+            if (cost < scratch.cost[i] || (cost == scratch.cost[i] && wordLength >= scratch.take[i])) {
+                scratch.cost[i] = cost;
+                scratch.take[i] = (uint32_t)wordLength;
+                scratch.word[i] = word;
+            }
+        });
+    }
+    for (size_t i = 0; i < length; i += scratch.take[i]) {
+        if (scratch.word[i] != UINT32_MAX) {
+            out[scratch.word[i]]++;
+        }
+    }
+}
+
+void Segmenter::countText(const char* text, size_t length, std::vector<uint64_t>& out) {
+    size_t threads = std::thread::hardware_concurrency() + 1;
+    threadScratch.resize(threads);
+    threadCounts.resize(threads);
+    size_t chunks = parallelChunks(length, 1 << 20, [&](size_t chunk, size_t begin, size_t end) {
+        std::vector<uint64_t>& chunkCounts = chunk == 0 ? out : threadCounts[chunk];
+        chunkCounts.resize(dictionary.wordLimit(), 0);
+        RunScratch& scratch = threadScratch[chunk];
+        const char* p = text + chunkBoundary(text, length, begin);
+        const char* chunkEnd = text + chunkBoundary(text, length, end);
+        const char* runStart = nullptr;
+        while (p < chunkEnd) {
+            uint32_t c;
+            int charLength = decodeUtf8(p, text + length, &c);
+            bool hanzi = isHanziCodepoint(c);
+            if (hanzi && !runStart) {
+                runStart = p;
+            } else if (!hanzi && runStart) {
+                countRun(runStart, p - runStart, scratch, chunkCounts);
+                runStart = nullptr;
+            }
+            p += charLength;
+        }
+        if (runStart) {
+            countRun(runStart, p - runStart, scratch, chunkCounts);
+        }
+    });
+    for (size_t chunk = 1; chunk < chunks; chunk++) {
+        std::vector<uint64_t>& chunkCounts = threadCounts[chunk];
+        for (size_t word = 0; word < chunkCounts.size(); word++) {
+            out[word] += chunkCounts[word];
+            chunkCounts[word] = 0;
+        }
+    }
+    bytes += length;
+}
+
+bool Segmenter::countFile(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    counts.resize(dictionary.wordLimit(), 0);
+    std::vector<char> block(BLOCK_SIZE);
+    size_t carried = 0; // bytes after the last safe cut of the previous block
+    for (;;) {
+        size_t read = fread(block.data() + carried, 1, block.size() - carried, file);
+        size_t filled = carried + read;
+        if (filled == 0) {
+            break;
+        }
+        size_t cut = filled;
+        if (read > 0 && filled == block.size()) {
+            // hold back everything after the last ASCII byte, so a run split by the block end is counted whole
+            cut = 0;
+            for (size_t i = filled; i-- > 0 && filled - i < 65536;) {
+                if ((unsigned char)block[i] < 0x80) {
+                    cut = i + 1;
+                    break;
+                }
+            }
+            if (cut == 0) {
+                cut = chunkBoundary(block.data(), filled, filled - 4);
+            }
+        }
+        countText(block.data(), cut, counts);
+        carried = filled - cut;
+        memmove(block.data(), block.data() + cut, carried);
+        if (read == 0) {
+            break;
+        }
+    }
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "dictionary.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Splits Chinese text into dictionary words and counts them. Each run of hanzi is cut into
+// the fewest dictionary words, longer first words breaking ties, by a shortest path over the
+// DAG of every word starting at every character; characters no word covers count as nothing.
+// Files are streamed a block at a time and each block is split across threads at
+// non-hanzi bytes, so memory stays bounded however large the corpus.
+class Segmenter {
+public:
+    explicit Segmenter(const Dictionary& dictionary) : dictionary(dictionary) {}
+
+    bool countFile(const char* path);
+    // Adds the words of 'text' to 'counts', indexed by Dictionary word and sized wordLimit()
+    void countText(const char* text, size_t length, std::vector<uint64_t>& counts);
+
+    // Occurrences per Dictionary word, across everything counted so far
+    const std::vector<uint64_t>& wordCounts() const { return counts; }
+    uint64_t bytesCounted() const { return bytes; }
+
+private:
+    // Dynamic-programming scratch for one run of hanzi, one per thread
+    typedef struct RunScratch {
+        std::vector<uint32_t> cost;   // fewest words covering the run from each byte
+        std::vector<uint32_t> take;   // length of the first of those words
+        std::vector<uint32_t> word;   // that word, or UINT32_MAX for a lone unknown character
+    } RunScratch;
+
+    void countRun(const char* run, size_t length, RunScratch& scratch, std::vector<uint64_t>& counts) const;
+
+    const Dictionary& dictionary;
+    std::vector<uint64_t> counts;
+    std::vector<std::vector<uint64_t>> threadCounts;
+    std::vector<RunScratch> threadScratch;
+    uint64_t bytes = 0;
+};
@@ -0,0 +1,188 @@
+#include "session_queue.h"
+#include <algorithm>
+
+// xorshift: the queue's shape must not draw from the session's shuffle generator, or
+// replays would change with it
+uint32_t SessionQueue::nextPriority() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+uint32_t SessionQueue::newNode(CardId card) {
+    uint32_t node;
+    if (!freeNodes.empty()) {
+        node = freeNodes.back();
+        freeNodes.pop_back();
+    } else {
+        node = (uint32_t)nodes.size();
+        nodes.push_back(Node{});
+    }
+    nodes[node] = Node{ card, nextPriority(), 1, NONE, NONE, NONE };
+    if (card >= nodeOfCard.size()) {
+        nodeOfCard.resize(card + 1, NONE);
+    }
+    nodeOfCard[card] = node;
+    return node;
+}
+
+void SessionQueue::update(uint32_t node) {
+    Node& n = nodes[node];
+    n.count = 1;
+    if (n.left != NONE) {
+        n.count += nodes[n.left].count;
+        nodes[n.left].parent = node;
+    }
+    if (n.right != NONE) {
+        n.count += nodes[n.right].count;
+        nodes[n.right].parent = node;
+    }
+}
+
+void SessionQueue::setRoot(uint32_t node) {
+    root = node;
+    if (root != NONE) {
+        nodes[root].parent = NONE;
+    }
+}
+
+// Builds the Cartesian tree of random priorities left to right: each new card is the
+// rightmost node, so it goes on the right spine, below the last node that outranks it
+void SessionQueue::assign(const std::vector<CardId>& cards) {
+    clear();
+    nodes.reserve(cards.size());
+    freeNodes.reserve(cards.size());
+    CardId largest = 0;
+    for (CardId card : cards) {
+        largest = std::max(largest, card);
+    }
+    nodeOfCard.resize(std::max<size_t>(nodeOfCard.size(), cards.empty() ? 0 : largest + 1), NONE);
+    std::vector<uint32_t> spine;
+    for (CardId card : cards) {
+        uint32_t node = newNode(card);
+        uint32_t last = NONE;
+        while (!spine.empty() && nodes[spine.back()].priority < nodes[node].priority) {
+            last = spine.back();
+            spine.pop_back();
+            update(last);
+        }
+        nodes[node].left = last;
+        if (!spine.empty()) {
+            nodes[spine.back()].right = node;
+        }
+        spine.push_back(node);
+    }
+    while (!spine.empty()) {
+        update(spine.back());
+        setRoot(spine.back());
+        spine.pop_back();
+    }
+}
+
+void SessionQueue::clear() {
+    for (const Node& node : nodes) {
+        nodeOfCard[node.card] = NONE;
+    }
+    nodes.clear();
+    freeNodes.clear();
+    root = NONE;
+}
+
+CardId SessionQueue::at(uint32_t position) const {
+    uint32_t node = root;
+    while (true) {
+        const Node& n = nodes[node];
+        uint32_t leftCount = n.left == NONE ? 0 : nodes[n.left].count;
+        if (position < leftCount) {
+            node = n.left;
+        } else if (position == leftCount) {
+            return n.card;
+        } else {
+            position -= leftCount + 1;
+            node = n.right;
+        }
+    }
+}
+
+void SessionQueue::split(uint32_t node, uint32_t position, uint32_t& left, uint32_t& right) {
+    if (node == NONE) {
+        left = right = NONE;
+        return;
+    }
+    Node& n = nodes[node];
+    uint32_t leftCount = n.left == NONE ? 0 : nodes[n.left].count;
+    if (position <= leftCount) {
+        split(n.left, position, left, nodes[node].left);
+        right = node;
+    } else {
+        split(n.right, position - leftCount - 1, nodes[node].right, right);
+        left = node;
+    }
+    update(node);
+}
+
+uint32_t SessionQueue::merge(uint32_t left, uint32_t right) {
+    if (left == NONE) {
+        return right;
+    }
+    if (right == NONE) {
+        return left;
+    }
+    if (nodes[left].priority > nodes[right].priority) {
+        nodes[left].right = merge(nodes[left].right, right);
+        update(left);
+        return left;
+    }
+    nodes[right].left = merge(left, nodes[right].left);
+    update(right);
+    return right;
+}
+
+void SessionQueue::insert(uint32_t position, CardId card) {
+    uint32_t node = newNode(card);
+    uint32_t left, right;
+    split(root, position, left, right);
+    setRoot(merge(merge(left, node), right));
+}
+
+CardId SessionQueue::erase(uint32_t position) {
+    uint32_t left, middle, right;
+    split(root, position, left, right);
+    split(right, 1, middle, right);
+    setRoot(merge(left, right));
+    freeNodes.push_back(middle);
+    CardId card = nodes[middle].card;
+    nodeOfCard[card] = NONE;
+    return card;
+}
+
+// The cards before this one are its left subtree, plus, for each ancestor it is right of,
+// that ancestor and the ancestor's left subtree
+uint32_t SessionQueue::positionOf(CardId card) const {
+    uint32_t node = nodeOfCard[card];
+    uint32_t position = nodes[node].left == NONE ? 0 : nodes[nodes[node].left].count;
+    for (uint32_t parent = nodes[node].parent; parent != NONE; node = parent, parent = nodes[node].parent) {
+        if (nodes[parent].right == node) {
+            position += 1 + (nodes[parent].left == NONE ? 0 : nodes[nodes[parent].left].count);
+        }
+    }
+    return position;
+}
+
+void SessionQueue::copyTo(std::vector<CardId>& out) const {
+    out.clear();
+    out.reserve(size());
+    std::vector<uint32_t> stack;
+    uint32_t node = root;
+    while (node != NONE || !stack.empty()) {
+        while (node != NONE) {
+            stack.push_back(node);
+            node = nodes[node].left;
+        }
+        node = stack.back();
+        stack.pop_back();
+        out.push_back(nodes[node].card);
+        node = nodes[node].right;
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "card_store.h"
+#include <stdint.h>
+#include <vector>
+
+// The cards still to answer in a session, in order. Answers take the front card and may put
+// it back anywhere, so this is an implicit treap: a tree ordered by position, balanced by
+// random priorities, where every node knows the size of its subtree. Reading, inserting or
+// removing at any position is O(log n) expected, as is finding where a card is, by walking
+// up from its node. Nodes live in one array and are recycled, so nothing is allocated after
+// assign(). Each card may be in the queue at most once.
+class SessionQueue {
+public:
+    // Replaces the contents in O(n)
+    void assign(const std::vector<CardId>& cards);
+    void clear();
+    uint32_t size() const { return root == NONE ? 0 : nodes[root].count; }
+    bool empty() const { return root == NONE; }
+
+    CardId at(uint32_t position) const;
+    CardId front() const { return at(0); }
+    // Afterwards the card is at 'position'; position == size() appends
+    void insert(uint32_t position, CardId card);
+    CardId erase(uint32_t position);
+    uint32_t positionOf(CardId card) const;
+    // All the cards in order
+    void copyTo(std::vector<CardId>& out) const;
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    typedef struct Node {
+        CardId card;
+        uint32_t priority;  // larger is nearer the root
+        uint32_t count;     // nodes in this subtree
+        uint32_t left;
+        uint32_t right;
+        uint32_t parent;
+    } Node;
+
+    uint32_t newNode(CardId card);
+    uint32_t nextPriority();
+    // Recounts the node and points its children back at it
+    void update(uint32_t node);
+    void setRoot(uint32_t node);
+    // The first 'position' cards of the subtree go to 'left', the rest to 'right'
+    void split(uint32_t node, uint32_t position, uint32_t& left, uint32_t& right);
+    uint32_t merge(uint32_t left, uint32_t right);
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> freeNodes;
+    std::vector<uint32_t> nodeOfCard;   // by CardId, for the cards in the queue
+    uint32_t root = NONE;
+    uint32_t seed = 0x9E3779B9u;
+};
@@ -0,0 +1,167 @@
+#include "session_snapshot.h"
+#include "alloc_profiler.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+// Between background writes, so answering quickly doesn't mean writing on every card
+static const int SNAPSHOT_INTERVAL_MS = 2000;
+
+static const char snapshotMagic[4] = { 'F', 'C', 'S', 'S' };
+static const uint32_t snapshotVersion = 1;
+
+typedef struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t libraryCards;
+    uint32_t lessonCount;
+    uint32_t activeCount;
+    uint32_t inactiveCount;
+    uint8_t fields;
+    uint8_t typedAnswers;
+    uint8_t weighted;
+    uint8_t padding;
+} SnapshotHeader;
+
+// Written beside the real file and renamed over it, so a crash mid-write leaves the old one
+bool saveSessionSnapshot(const char* path, const SessionSnapshot& snapshot) {
+    SnapshotHeader header = {};
+    memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+    header.version = snapshotVersion;
+    header.libraryCards = snapshot.libraryCards;
+    header.lessonCount = snapshot.lessonCount;
+    header.activeCount = (uint32_t)snapshot.active.size();
+    header.inactiveCount = (uint32_t)snapshot.inactive.size();
+    header.fields = snapshot.fields;
+    header.typedAnswers = snapshot.typedAnswers;
+    header.weighted = snapshot.weighted;
+
+    std::string temporary = std::string(path) + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(snapshot.active.data(), sizeof(CardId), snapshot.active.size(), file) == snapshot.active.size()
+        && fwrite(snapshot.inactive.data(), sizeof(CardId), snapshot.inactive.size(), file) == snapshot.inactive.size()
+        && fwrite(snapshot.status.data(), 1, snapshot.status.size(), file) == snapshot.status.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(temporary.c_str(), path) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool loadSessionSnapshot(const char* path, SessionSnapshot& snapshot) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    SnapshotHeader header;
+    bool ok = size >= (long)sizeof(header) && fread(&header, sizeof(header), 1, file) == 1
+        && memcmp(header.magic, snapshotMagic, sizeof(snapshotMagic)) == 0
+        && header.version == snapshotVersion
+        && (uint64_t)size == sizeof(header) + ((uint64_t)header.activeCount + header.inactiveCount) * (sizeof(CardId) + 1);
+    if (ok) {
+        snapshot.active.resize(header.activeCount);
+        snapshot.inactive.resize(header.inactiveCount);
+        snapshot.status.resize((size_t)header.activeCount + header.inactiveCount);
+        ok = fread(snapshot.active.data(), sizeof(CardId), snapshot.active.size(), file) == snapshot.active.size()
+            && fread(snapshot.inactive.data(), sizeof(CardId), snapshot.inactive.size(), file) == snapshot.inactive.size()
+            && fread(snapshot.status.data(), 1, snapshot.status.size(), file) == snapshot.status.size();
+    }
+    fclose(file);
+    if (!ok) {
+        return false;
+    }
+    snapshot.libraryCards = header.libraryCards;
+    snapshot.lessonCount = header.lessonCount;
+    snapshot.fields = header.fields;
+    snapshot.typedAnswers = header.typedAnswers;
+    snapshot.weighted = header.weighted;
+    for (const std::vector<CardId>* ids : { &snapshot.active, &snapshot.inactive }) {
+        for (CardId id : *ids) {
+            if (id >= snapshot.libraryCards) {
+                return false;
+            }
+        }
+    }
+    for (uint8_t status : snapshot.status) {
+        if (status > UNDECIDED) {
+            return false;
+        }
+    }
+    return true;
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    stop();
+}
+
+void SnapshotWriter::start(const char* snapshotPath) {
+    path = snapshotPath;
+    worker = std::thread(&SnapshotWriter::run, this);
+}
+
+void SnapshotWriter::submit(SessionSnapshot& snapshot) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::swap(pending, snapshot);
+        action = SNAPSHOT_WRITE;
+    }
+    wake.notify_one();
+}
+
+void SnapshotWriter::discard() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        action = SNAPSHOT_REMOVE;
+    }
+    wake.notify_one();
+}
+
+void SnapshotWriter::stop() {
+    if (!worker.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void SnapshotWriter::run() {
+    AllocScope scope(ALLOC_SNAPSHOT);
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || action != SNAPSHOT_NONE; });
+        Action next = action;
+        action = SNAPSHOT_NONE;
+        if (next == SNAPSHOT_WRITE) {
+            std::swap(writing, pending);
+        }
+        lock.unlock();
+
+        if (next == SNAPSHOT_WRITE) {
+            saveSessionSnapshot(path.c_str(), writing);
+        } else if (next == SNAPSHOT_REMOVE) {
+            remove(path.c_str());
+        }
+
+        lock.lock();
+        if (stopping) {
+            if (action == SNAPSHOT_NONE) {
+                return;
+            }
+            continue; // the last submission before stopping is still written
+        }
+        // rest before the next write, unless told to stop
+        wake.wait_for(lock, std::chrono::milliseconds(SNAPSHOT_INTERVAL_MS), [this] { return stopping; });
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "card_store.h"
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A session in progress: which cards are left and which are done, in order, with the
+// status of each. Ids are only meaningful for the library they were saved from, so the
+// library's size is recorded alongside.
+typedef struct SessionSnapshot {
+    uint32_t libraryCards;
+    uint32_t lessonCount;
+    uint8_t fields;                 // FlashcardField bits
+    uint8_t typedAnswers;
+    uint8_t weighted;               // the next card is drawn by difficulty
+    std::vector<CardId> active;     // the card on show first
+    std::vector<CardId> inactive;
+    std::vector<uint8_t> status;    // CardStatus of each active card, then each inactive one
+} SessionSnapshot;
+
+// The file is a fixed header followed by the three arrays as they are in memory, so
+// loading is one read and a check that every id is inside the library
+bool saveSessionSnapshot(const char* path, const SessionSnapshot& snapshot);
+bool loadSessionSnapshot(const char* path, SessionSnapshot& snapshot);
+
+// Writes snapshots on a worker thread, at most one per interval however often they are
+// submitted; a newer snapshot replaces one still waiting. Submitting swaps buffers with
+// the caller rather than copying, so steady use doesn't allocate.
+class SnapshotWriter {
+public:
+    ~SnapshotWriter();
+
+    void start(const char* path);
+    // Takes 'snapshot' and leaves the caller a spare buffer to fill next time
+    void submit(SessionSnapshot& snapshot);
+    // Deletes the file, after any write still waiting is dropped
+    void discard();
+    // Finishes what is waiting, then stops the worker
+    void stop();
+
+private:
+    typedef enum Action {
+        SNAPSHOT_NONE,
+        SNAPSHOT_WRITE,
+        SNAPSHOT_REMOVE
+    } Action;
+
+    void run();
+
+    std::string path;
+    std::mutex mutex;
+    std::condition_variable wake;
+    SessionSnapshot pending = {};
+    SessionSnapshot writing = {};
+    Action action = SNAPSHOT_NONE;
+    bool stopping = false;
+    std::thread worker;
+};
@@ -0,0 +1,116 @@
+#include "text_layout.h"
+#include <string.h>
+
+TextLayoutCache textLayouts;
+
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static void measure(TextLayout& layout, std::string_view text, ImFont* font, float fontSize, float wrapWidth) {
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    float scale = fontSize / font->FontSize;
+    const char* lineStart = begin;
+    do {
+        const char* lineEnd = end;
+        if (wrapWidth > 0.0f) {
+            lineEnd = font->CalcWordWrapPositionA(scale, lineStart, end, wrapWidth);
+            if (lineEnd == lineStart) {
+                lineEnd++; // always make progress, even if a single glyph does not fit
+            }
+        }
+        const char* next = lineEnd;
+        while (lineEnd > lineStart && lineEnd[-1] == ' ') {
+            lineEnd--;
+        }
+        while (next < end && *next == ' ') {
+            next++;
+        }
+        TextLine line;
+        line.begin = (uint32_t)(lineStart - begin);
+        line.end = (uint32_t)(lineEnd - begin);
+        line.width = font->CalcTextSizeA(fontSize, FLT_MAX, 0.0f, lineStart, lineEnd).x;
+        layout.lines.push_back(line);
+        if (line.width > layout.width) {
+            layout.width = line.width;
+        }
+        lineStart = next;
+    } while (lineStart < end);
+}
+
+static uint64_t layoutKey(std::string_view text, ImFont* font, float fontSize, float wrapWidth) {
+    uint64_t key = hashBytes(0xcbf29ce484222325ull, text.data(), text.size());
+    key = hashBytes(key, &font, sizeof(font));
+    key = hashBytes(key, &fontSize, sizeof(fontSize));
+    return hashBytes(key, &wrapWidth, sizeof(wrapWidth));
+}
+
+const TextLayout& TextLayoutCache::get(std::string_view text, float wrapWidth) {
+    ImFont* font = ImGui::GetFont();
+    float fontSize = ImGui::GetFontSize();
+    uint64_t key = layoutKey(text, font, fontSize, wrapWidth);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = entries.find(key);
+    if (found != entries.end() && found->second.matches(text, font, fontSize, wrapWidth)) {
+        return found->second.layout;
+    }
+
+    // miss, or a hash collision: (re)measure into this slot
+    Entry& entry = entries[key];
+    entry.text = text;
+    entry.font = font;
+    entry.fontSize = fontSize;
+    entry.wrapWidth = wrapWidth;
+    entry.layout = TextLayout();
+    measure(entry.layout, text, font, fontSize, wrapWidth);
+    return entry.layout;
+}
+
+bool TextLayoutCache::contains(std::string_view text, ImFont* font, float fontSize, float wrapWidth) {
+    uint64_t key = layoutKey(text, font, fontSize, wrapWidth);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = entries.find(key);
+    return found != entries.end() && found->second.matches(text, font, fontSize, wrapWidth);
+}
+
+void TextLayoutCache::prepare(std::string_view text, ImFont* font, float fontSize, float wrapWidth) {
+    uint64_t key = layoutKey(text, font, fontSize, wrapWidth);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (entries.count(key)) {
+            return; // already there (or a collision, which get() will sort out)
+        }
+    }
+
+    Entry entry;
+    entry.text = text;
+    entry.font = font;
+    entry.fontSize = fontSize;
+    entry.wrapWidth = wrapWidth;
+    measure(entry.layout, text, font, fontSize, wrapWidth);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.emplace(key, std::move(entry));
+}
+
+void TextLayoutCache::invalidateIfStale() {
+    ImGuiIO& io = ImGui::GetIO();
+    if (io.Fonts->TexID != atlasTexture || io.FontGlobalScale != fontScale
+        || io.DisplayFramebufferScale.x != framebufferScale.x || io.DisplayFramebufferScale.y != framebufferScale.y) {
+        clear();
+        atlasTexture = io.Fonts->TexID;
+        fontScale = io.FontGlobalScale;
+        framebufferScale = io.DisplayFramebufferScale;
+    }
+}
+
+void TextLayoutCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+}
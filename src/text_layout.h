@@ -0,0 +1,64 @@
+#pragma once
+
+#include "imgui.h"
+#include <stdint.h>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Measured (and, past the wrap width, line-broken) text, so card pages can
+// center their strings without calling CalcTextSize every frame.
+// get() and invalidation belong to the UI thread; prepare() may be called from
+// a worker as long as the font atlas is not rebuilt meanwhile.
+
+typedef struct TextLine {
+    uint32_t begin;     // byte offsets into the measured string
+    uint32_t end;
+    float width;
+} TextLine;
+
+typedef struct TextLayout {
+    std::vector<TextLine> lines;
+    float width = 0.0f; // widest line
+} TextLayout;
+
+class TextLayoutCache {
+public:
+    // Measures with the current font on a miss. wrapWidth <= 0 disables wrapping.
+    const TextLayout& get(std::string_view text, float wrapWidth);
+
+    bool contains(std::string_view text, ImFont* font, float fontSize, float wrapWidth);
+    // Measures into the cache ahead of time, without touching the ImGui context
+    void prepare(std::string_view text, ImFont* font, float fontSize, float wrapWidth);
+
+    // Drops every layout if the font atlas or display scale changed since the
+    // last call. Call once per frame, before any get().
+    void invalidateIfStale();
+    void clear();
+    size_t size() const { return entries.size(); }
+
+private:
+    typedef struct Entry {
+        std::string text;
+        ImFont* font;
+        float fontSize;
+        float wrapWidth;
+        TextLayout layout;
+
+        bool matches(std::string_view t, ImFont* f, float size, float wrap) const {
+            return font == f && fontSize == size && wrapWidth == wrap && text == t;
+        }
+    } Entry;
+
+    // Entries are never erased except by clear(), so references returned by
+    // get() stay valid while a worker inserts new ones
+    std::unordered_map<uint64_t, Entry> entries;
+    std::mutex mutex;
+    ImTextureID atlasTexture = nullptr;
+    float fontScale = 0.0f;
+    ImVec2 framebufferScale = ImVec2(0.0f, 0.0f);
+};
+
+extern TextLayoutCache textLayouts;
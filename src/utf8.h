@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+// Decodes one UTF-8 sequence starting at 'text', returning the number of bytes
+// consumed (at least 1). Malformed input decodes to U+FFFD.
+static inline int decodeUtf8(const char* text, const char* end, uint32_t* codepoint) {
+    const unsigned char* s = (const unsigned char*)text;
+    int available = (int)(end - text);
+    unsigned char c = s[0];
+    int length = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 0;
+    if (length == 0 || length > available) {
+        *codepoint = 0xFFFD;
+        return 1;
+    }
+    uint32_t value = length == 1 ? c : c & (0x7F >> length);
+    for (int i = 1; i < length; i++) {
+        if ((s[i] & 0xC0) != 0x80) {
+            *codepoint = 0xFFFD;
+            return i;
+        }
+        value = (value << 6) | (s[i] & 0x3F);
+    }
+    *codepoint = value;
+    return length;
+}
+
+// CJK ideographs: the radical blocks, both unified ideograph blocks and their extension
+// planes, and the compatibility ideographs. Not kana, Hangul, or the full-width
+// punctuation and symbols that sit between them.
+static inline bool isHanziCodepoint(uint32_t c) {
+    return (c >= 0x2E80 && c <= 0x2FDF) || (c >= 0x3400 && c <= 0x4DBF) || (c >= 0x4E00 && c <= 0x9FFF)
+        || (c >= 0xF900 && c <= 0xFAFF) || (c >= 0x20000 && c <= 0x3FFFF);
+}